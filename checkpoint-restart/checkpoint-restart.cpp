@@ -0,0 +1,202 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "cubeBenchmark.h"
+
+#include "palabos3D.h"
+#include "palabos3D.hh"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace hemo;
+
+namespace {
+
+/* Total size of the regular files in a directory (not recursive), without
+ * the *.old copies hemocell keeps of the previous checkpoint */
+double directoryBytes(std::string const & directory) {
+  static const std::string old = ".old";
+  double bytes = 0.;
+  DIR * dir = opendir(directory.c_str());
+  if (!dir) { return bytes; }
+  while (dirent * entry = readdir(dir)) {
+    struct stat info;
+    std::string name = entry->d_name;
+    if (name.size() >= old.size() && name.compare(name.size() - old.size(), old.size(), old) == 0) { continue; }
+    std::string path = directory + "/" + name;
+    if (stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+      bytes += info.st_size;
+    }
+  }
+  closedir(dir);
+  return bytes;
+}
+
+}
+
+/*
+ * Cube benchmark that measures the cost of hemocell.saveCheckPoint() and
+ * hemocell.loadCheckPoint() and checks that a restart is equivalent.
+ *
+ * A checkpoint is saved every <tcheckpoint> iterations. At <trestart> a
+ * checkpoint is saved and immediately loaded again, the run continues from
+ * the loaded state. The statistics before the save and after the load must
+ * be equal, and the mean iteration time of the <driftWindow> iterations
+ * before the restart is compared to the same number of iterations after it
+ * (the first iteration after the restart is reported on its own, the
+ * restart latency is the load time plus that iteration).
+ *
+ * The write and read bandwidth per process is the size of the checkpoint
+ * directory (<checkpointPath>) divided by the number of processes and the
+ * time of that process.
+ */
+class CheckpointRestart : public bench::CubeBenchmark {
+public:
+  CheckpointRestart(int argc, char *argv[]) : bench::CubeBenchmark(argc, argv)
+  {
+    tcheckpoint = benchmarkOption<unsigned int>("tcheckpoint", tmax / 4);
+    trestart = benchmarkOption<unsigned int>("trestart", tmax / 2);
+    driftWindow = benchmarkOption<unsigned int>("driftWindow", 50);
+    checkpointPath = benchmarkOption<std::string>("checkpointPath",
+                       (*cfg)["parameters"]["outputDirectory"].read<std::string>() + "/checkpoint");
+    hlog << "tcheckpoint : " << tcheckpoint << ", trestart : " << trestart
+         << ", driftWindow : " << driftWindow << endl;
+
+    if (checkpointMode != "hemocell") {
+      hlog << "(CheckpointRestart) (Error) only measures the hemocell checkpoint, set <checkpointMode> hemocell" << endl;
+      exit(1);
+    }
+  }
+
+protected:
+  void step() override {
+    double start = MPI_Wtime();
+    bench::CubeBenchmark::step();
+    double seconds = MPI_Wtime() - start;
+
+    if (restarted && hemocell.iter == trestart + 1) {
+      firstIteration = seconds;
+    } else if (!restarted && hemocell.iter + driftWindow > trestart && hemocell.iter <= trestart) {
+      before.push_back(seconds);
+    } else if (restarted && hemocell.iter > trestart + 1 && hemocell.iter <= trestart + 1 + driftWindow) {
+      after.push_back(seconds);
+    }
+  }
+
+  void afterIteration() override {
+    bench::CubeBenchmark::afterIteration();
+
+    if (!restarted && hemocell.iter == trestart) {
+      restart();
+    } else if (tcheckpoint > 0 && hemocell.iter > 0 && hemocell.iter % tcheckpoint == 0) {
+      save();
+    }
+  }
+
+  /* Save a checkpoint, returns the time of this process */
+  double save() {
+    global::mpi().barrier();
+    double start = MPI_Wtime();
+    hemocell.saveCheckPoint();
+    double seconds = MPI_Wtime() - start;
+    global::mpi().barrier();
+
+    saveSeconds += seconds;
+    nSaves++;
+    hlog << "(CheckpointRestart) saved @ " << hemocell.iter << " in " << seconds << " s" << endl;
+    return seconds;
+  }
+
+  void restart() {
+    // not the tmeas statistics, those only have the forces when the benchmark sets forceStatistics
+    bench::FusedStatistics restartStatistics(hemocell, cellTypes, true);
+    bench::StatisticsSummary reference = restartStatistics.compute();
+    unsigned int iteration = hemocell.iter;
+
+    double writeSeconds = save();
+    double bytes = checkpointBytes();
+
+    global::mpi().barrier();
+    double start = MPI_Wtime();
+    hemocell.loadCheckPoint();
+    readSeconds = MPI_Wtime() - start;
+    global::mpi().barrier();
+    restarted = true;
+
+    bench::StatisticsSummary const & loaded = restartStatistics.compute();
+    bool equivalent = hemocell.iter == iteration && loaded.cells == reference.cells &&
+                      loaded.velocityMax == reference.velocityMax && loaded.velocityMean == reference.velocityMean &&
+                      loaded.forceMax == reference.forceMax && loaded.forceMean == reference.forceMean;
+    hlog << "(CheckpointRestart) restarted @ " << hemocell.iter << " in " << readSeconds << " s, "
+         << (equivalent ? "equivalent" : "NOT equivalent") << endl;
+
+    const double bytesPerProcess = bytes / global::mpi().getSize();
+    hemo::global.statistics.addMetric("Checkpoint Bytes", bytes);
+    hemo::global.statistics.addMetric("Checkpoint Write Bandwidth", bytesPerProcess / writeSeconds / 1.0e6);
+    hemo::global.statistics.addMetric("Checkpoint Read Bandwidth", bytesPerProcess / readSeconds / 1.0e6);
+    hemo::global.statistics.addMetric("Checkpoint Load Time", readSeconds);
+    hemo::global.statistics.addMetric("Restart Equivalent", std::string(equivalent ? "yes" : "no"));
+  }
+
+  /* Size of the checkpoint directory, measured on rank 0 */
+  double checkpointBytes() {
+    double bytes = global::mpi().isMainProcessor() ? directoryBytes(checkpointPath) : 0.;
+    global::mpi().bCast(&bytes, 1);
+    return bytes;
+  }
+
+  void finish() override {
+    double mean = nSaves > 0 ? saveSeconds / nSaves : 0.;
+    double beforeMean = 0., afterMean = 0.;
+    for (double seconds : before) { beforeMean += seconds / before.size(); }
+    for (double seconds : after) { afterMean += seconds / after.size(); }
+
+    hemo::global.statistics.addMetric("Checkpoint Saves", (double)nSaves);
+    hemo::global.statistics.addMetric("Checkpoint Save Time", mean);
+    hemo::global.statistics.addMetric("Restart Latency", readSeconds + firstIteration);
+    hemo::global.statistics.addMetric("Iteration Time Before Restart", beforeMean);
+    hemo::global.statistics.addMetric("Iteration Time After Restart", afterMean);
+    hemo::global.statistics.addMetric("Iteration Time Drift", beforeMean > 0. ? afterMean / beforeMean - 1. : 0.);
+    hlog << "(CheckpointRestart) iteration time before restart " << beforeMean << " s, after " << afterMean
+         << " s, first iteration after restart " << firstIteration << " s" << endl;
+
+    bench::CubeBenchmark::finish();
+  }
+
+  unsigned int tcheckpoint;
+  unsigned int trestart;
+  unsigned int driftWindow;
+  std::string checkpointPath;
+
+  bool restarted = false;
+  int nSaves = 0;
+  double saveSeconds = 0.;
+  double readSeconds = 0.;
+  double firstIteration = 0.;
+  std::vector<double> before, after;
+};
+
+int main(int argc, char *argv[]) {
+  return bench::runBenchmark<CheckpointRestart>(argc, argv);
+}
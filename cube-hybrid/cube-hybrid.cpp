@@ -0,0 +1,84 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "cubeBenchmark.h"
+#include "threadedLattice.h"
+
+#include "palabos3D.h"
+#include "palabos3D.hh"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace hemo;
+
+/*
+ * The cube benchmark with fewer MPI processes and an OpenMP thread team per
+ * process: the atomic blocks of a process are collided and streamed in
+ * parallel, the envelope exchange and the IBM part of the iteration stay on
+ * the main thread. The number of threads is set with OMP_NUM_THREADS.
+ */
+class HybridCube : public bench::CubeBenchmark {
+public:
+  HybridCube(int argc, char *argv[]) : bench::CubeBenchmark(argc, argv)
+  {
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    hlog << "(main) OpenMP threads per process: " << threads << endl;
+    hemo::global.statistics.addMetric("OpenMP Threads", (double)threads);
+
+    // MPI is only called from the main thread, outside of parallel regions
+    int provided;
+    MPI_Query_thread(&provided);
+    if (threads > 1 && provided < MPI_THREAD_FUNNELED) {
+      hlog << "(main) (Warning) MPI was not initialized with MPI_THREAD_FUNNELED" << endl;
+    }
+  }
+
+protected:
+  void createLattice() override {
+    // the scaling mode decides the blocks itself
+    if (!scalingGrid.empty()) {
+      bench::CubeBenchmark::createLattice();
+      return;
+    }
+    // by default every thread of a process gets one block
+    createAttributedLattice(global::mpi().getSize() * benchmarkOption<int>("blockMultiply", threads), "contiguous");
+  }
+
+  MultiBlockLattice3D<T,DESCRIPTOR> * newLattice(MultiBlockManagement3D const & management) override {
+    return new bench::ThreadedMultiBlockLattice3D<T,DESCRIPTOR>(management,
+              defaultMultiBlockPolicy3D().getBlockCommunicator(),
+              defaultMultiBlockPolicy3D().getCombinedStatistics(),
+              defaultMultiBlockPolicy3D().getMultiCellAccess<T, DESCRIPTOR>(),
+              new GuoExternalForceBGKdynamics<T, DESCRIPTOR>(1.0/param::tau));
+  }
+
+  int threads = 1;
+};
+
+int main(int argc, char *argv[]) {
+  return bench::runBenchmark<HybridCube>(argc, argv);
+}
@@ -0,0 +1,43 @@
+#!/bin/bash
+# Submit the cube-hybrid benchmark for every ranks x threads split of a node.
+#
+# usage: ./submit_sweep.sh <config.xml> [nodes] [cores per node]
+# run from cube-hybrid/snellius-scripts, every job runs in its own directory
+# sweep/<ranks>x<threads>. Compare the iterate timers and the imbalance
+# report of the jobs to find the best split.
+
+config=${1:-config.xml}
+nodes=${2:-1}
+cores=${3:-128}
+
+for threads in 1 2 4 8 16 32 64 128; do
+  if [ $threads -gt $cores ] || [ $((cores % threads)) -ne 0 ]; then
+    continue
+  fi
+  ranks=$((cores / threads))
+  dir=sweep/${ranks}x${threads}
+  mkdir -p $dir
+  cp ../${config} ../cube-hybrid ../../misc/RBC.xml ../../misc/PLT.xml ../../misc/PLT.pos $dir/
+  cp ../../misc/RBC-h018.pos $dir/RBC.pos
+
+  sbatch --chdir $dir <<JOB
+#!/bin/bash
+#SBATCH --partition thin
+#SBATCH -J cube_hybrid_${ranks}x${threads}
+#SBATCH --nodes ${nodes}
+#SBATCH --tasks-per-node ${ranks}
+#SBATCH --cpus-per-task ${threads}
+#SBATCH --exclusive
+#SBATCH --time 01:00:00
+
+# load modules for hemocell
+source "../../../../scripts/snellius_env.sh"
+
+export OMP_NUM_THREADS=${threads}
+export OMP_PLACES=cores
+export OMP_PROC_BIND=close
+
+#srun works better with the environment than mpirun
+srun --cpus-per-task ${threads} ./cube-hybrid $(basename ${config})
+JOB
+done
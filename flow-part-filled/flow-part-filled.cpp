@@ -0,0 +1,180 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "cubeBenchmark.h"
+#include "particleHelpers.h"
+#include "particleLoader.h"
+
+#include "palabos3D.h"
+#include "palabos3D.hh"
+
+#include <algorithm>
+#include <fstream>
+
+using namespace hemo;
+
+/*
+ * Channel flow through the cube, with only part of it filled with RBCs.
+ *
+ * The domain is periodic in x and y with walls at the bottom and top (z). A
+ * body force in x drives a Poiseuille flow whose wall shear rate is
+ * <domain><shearrate>. Only the RBCs of RBC.pos whose centre lies in the
+ * first <fillFraction> of the domain along x are created. The front of this
+ * RBC region moves through the periodic boundary, so the work per process
+ * changes during the run.
+ *
+ * Every <tslice> iterations the compute time of every process (the growth of
+ * its <rebalanceTimers>, see computeSeconds(), without the time spent waiting
+ * for the other processes) and its number of cell vertices are gathered. They are appended to
+ * <log directory>/imbalance.csv, and the imbalance of the slice is logged.
+ */
+class FlowPartFilled : public bench::CubeBenchmark {
+public:
+  FlowPartFilled(int argc, char *argv[]) : bench::CubeBenchmark(argc, argv)
+  {
+    tslice = benchmarkOption<unsigned int>("tslice", 200);
+    fillFraction = benchmarkOption<double>("fillFraction", 0.5);
+    hlog << "tslice : " << tslice << ", fill fraction : " << fillFraction << endl;
+  }
+
+protected:
+  void buildLattice() override {
+    hlog << "(FlowPartFilled) (Parameters) calculating flow parameters" << endl;
+    param::lbm_shear_parameters((*cfg), nz);
+    param::printParameters();
+
+    createLattice();
+    hemocell.lattice->toggleInternalStatistics(false);
+
+    // walls at the bottom and top, the flow leaves and enters through x
+    hemocell.lattice->periodicity().toggleAll(true);
+    hemocell.lattice->periodicity().toggle(2, false);
+    defineDynamics(*hemocell.lattice, Box3D(0, nx-1, 0, ny-1, 0, 0), new BounceBack<T, DESCRIPTOR>);
+    defineDynamics(*hemocell.lattice, Box3D(0, nx-1, 0, ny-1, nz-1, nz-1), new BounceBack<T, DESCRIPTOR>);
+
+    // Poiseuille flow between the walls: the wall shear rate is 4 u_max / H
+    // and the force that sustains it is 8 nu u_max / H^2
+    const T height = nz - 2;
+    const T uMax = (*cfg)["domain"]["shearrate"].read<T>() * param::dt * height / 4.;
+    bodyForce = 8. * param::nu_lbm * uMax / (height * height);
+    hlog << "(FlowPartFilled) body force " << bodyForce << " lf, u max " << uMax * param::dx / param::dt << " m/s" << endl;
+    hemo::global.statistics.addMetric("Body Force", bodyForce);
+
+    hemocell.latticeEquilibrium(1., plb::Array<T, 3>(0.0, 0.0, 0.0));
+    hlog << getMultiBlockInfo(*hemocell.lattice) << endl;
+    hemocell.lattice->initialize();
+    applyBodyForce();
+  }
+
+  void loadParticles() override {
+    // only cells with their centre in the filled part of the domain
+    Box3D filled(0, std::max<plint>(0, (plint)(fillFraction * nx) - 1), 0, ny - 1, 0, nz - 1);
+    loadParticlesScattered(hemocell, cellTypes, &filled);
+  }
+
+  void beforeLoop() override {
+    bench::CubeBenchmark::beforeLoop();
+    sliceStart = computeSeconds();
+  }
+
+  void step() override {
+    bench::CubeBenchmark::step();
+    // the force field is rebuilt every iteration, add the driving force again
+    applyBodyForce();
+  }
+
+  void afterIteration() override {
+    bench::CubeBenchmark::afterIteration();
+    if (tslice > 0 && hemocell.iter % tslice == 0) {
+      recordSlice();
+    }
+  }
+
+  void finish() override {
+    hemo::global.statistics.addMetric("Slice Imbalance Max", maxImbalance);
+    hemo::global.statistics.addMetric("Slice Imbalance Mean", nSlices > 0 ? imbalanceSum / nSlices : 0.);
+    bench::CubeBenchmark::finish();
+  }
+
+  void applyBodyForce() {
+    setExternalVector(*hemocell.lattice, hemocell.lattice->getBoundingBox(),
+                      DESCRIPTOR<T>::ExternalField::forceBeginsAt,
+                      plb::Array<T, DESCRIPTOR<T>::d>(bodyForce, 0.0, 0.0));
+  }
+
+  /* Gather the compute time and vertices of every process for the last slice */
+  void recordSlice() {
+    MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+    double vertices = 0.;
+    for (plint id : management.getLocalInfo().getBlocks()) {
+      Box3D const & bulk = management.getSparseBlockStructure().getBulks().at(id);
+      for (HemoCellParticle const & particle : hemocell.cellfields->immersedParticles->getComponent(id).particles) {
+        if (bench::inBulk(bulk, particle.sv.position)) { vertices += 1.; }
+      }
+    }
+
+    const int nProcs = global::mpi().getSize();
+    double compute = computeSeconds();
+    double local[2] = {compute - sliceStart, vertices};
+    std::vector<double> all(global::mpi().isMainProcessor() ? 2 * nProcs : 0);
+    MPI_Gather(local, 2, MPI_DOUBLE, all.data(), 2, MPI_DOUBLE, 0, global::mpi().getGlobalCommunicator());
+    sliceStart = compute;
+
+    double imbalance = 0.;
+    if (global::mpi().isMainProcessor()) {
+      if (!sliceFile.is_open()) {
+        sliceFile.open(plb::global::directories().getLogOutDir() + "imbalance.csv");
+        sliceFile << "iteration,rank,seconds,vertices\n";
+      }
+      double max = 0., mean = 0.;
+      for (int rank = 0; rank < nProcs; rank++) {
+        sliceFile << hemocell.iter << "," << rank << "," << all[2 * rank] << "," << all[2 * rank + 1] << "\n";
+        max = std::max(max, all[2 * rank]);
+        mean += all[2 * rank] / nProcs;
+      }
+      sliceFile.flush();
+      imbalance = mean > 0. ? (max / mean - 1.) * 100. : 0.;
+      hlog << "(FlowPartFilled) slice @ " << hemocell.iter << ": max " << max << " s, mean " << mean
+           << " s, imbalance " << imbalance << " %" << endl;
+    }
+    global::mpi().bCast(&imbalance, 1);
+
+    maxImbalance = std::max(maxImbalance, imbalance);
+    imbalanceSum += imbalance;
+    nSlices++;
+  }
+
+  unsigned int tslice;
+  double fillFraction;
+  T bodyForce = 0.;
+
+  /* computeSeconds() at the start of the current slice */
+  double sliceStart = 0.;
+  std::ofstream sliceFile;
+  double maxImbalance = 0., imbalanceSum = 0.;
+  int nSlices = 0;
+};
+
+int main(int argc, char *argv[]) {
+  return bench::runBenchmark<FlowPartFilled>(argc, argv);
+}
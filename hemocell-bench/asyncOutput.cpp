@@ -0,0 +1,230 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "asyncOutput.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#include <hdf5.h>
+#include <hdf5_hl.h>
+#include <sys/stat.h>
+
+namespace hemo {
+namespace bench {
+
+void OutputSnapshot::clear() {
+  nBlocks = 0;
+  nParticleTypes = 0;
+}
+
+BlockSnapshot & OutputSnapshot::addBlock() {
+  if (nBlocks == blocks.size()) { blocks.emplace_back(); }
+  BlockSnapshot & block = blocks[nBlocks++];
+  for (FieldSnapshot & f : block.fields) { f.values.clear(); }
+  return block;
+}
+
+ParticleSnapshot & OutputSnapshot::addParticles() {
+  if (nParticleTypes == particles.size()) { particles.emplace_back(); }
+  ParticleSnapshot & p = particles[nParticleTypes++];
+  p.nCells = 0;
+  for (FieldSnapshot & f : p.fields) { f.values.clear(); }
+  p.triangles.clear();
+  p.cellId.clear();
+  p.vertexId.clear();
+  return p;
+}
+
+FieldSnapshot & OutputSnapshot::field(std::vector<FieldSnapshot> & fields, std::string const & name, int components) {
+  for (FieldSnapshot & f : fields) {
+    if (f.name == name) { return f; }
+  }
+  fields.emplace_back();
+  fields.back().name = name;
+  fields.back().components = components;
+  return fields.back();
+}
+
+AsyncOutputWriter::AsyncOutputWriter(std::string const & directory_, int rank_, int nProcs_, std::size_t buffers) :
+directory(directory_), rank(rank_), nProcs(nProcs_), pool(buffers)
+{
+  for (std::size_t i = 0; i < buffers; i++) {
+    free.push_back(i);
+  }
+  writer = std::thread(&AsyncOutputWriter::run, this);
+}
+
+AsyncOutputWriter::~AsyncOutputWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  changed.notify_all();
+  writer.join();
+}
+
+OutputSnapshot & AsyncOutputWriter::acquire() {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (free.empty()) {
+    auto start = std::chrono::steady_clock::now();
+    changed.wait(lock, [this] { return !free.empty(); });
+    waited += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+  current = free.front();
+  free.pop_front();
+  pool[current].clear();
+  return pool[current];
+}
+
+void AsyncOutputWriter::submit() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queued.push_back(current);
+  }
+  changed.notify_all();
+}
+
+void AsyncOutputWriter::flush() {
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [this] { return queued.empty() && !busy; });
+}
+
+std::size_t AsyncOutputWriter::written() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return nWritten;
+}
+
+void AsyncOutputWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    changed.wait(lock, [this] { return stopping || !queued.empty(); });
+    if (queued.empty()) { return; }
+
+    std::size_t index = queued.front();
+    queued.pop_front();
+    busy = true;
+
+    lock.unlock();
+    write(pool[index]);
+    lock.lock();
+
+    busy = false;
+    nWritten++;
+    free.push_back(index);
+    changed.notify_all();
+  }
+}
+
+void AsyncOutputWriter::write(OutputSnapshot const & snapshot) {
+  char iteration[32];
+  std::snprintf(iteration, sizeof(iteration), "%012lld", (long long)snapshot.iteration);
+  std::string path = directory + "/hdf5/" + iteration;
+  mkdir(directory.c_str(), 0755);
+  mkdir((directory + "/hdf5").c_str(), 0755);
+  mkdir(path.c_str(), 0755);
+
+  writeFluid(snapshot, path, iteration);
+  for (std::size_t t = 0; t < snapshot.nParticleTypes; t++) {
+    writeCells(snapshot, snapshot.particles[t], path, iteration);
+  }
+}
+
+namespace {
+hid_t createFile(std::string const & filename) {
+  hid_t file = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  if (file < 0) {
+    std::cerr << "(AsyncOutput) (Error) cannot create " << filename << std::endl;
+  }
+  return file;
+}
+
+void writeAttributes(hid_t file, OutputSnapshot const & snapshot, int rank, int nProcs) {
+  long long iter = snapshot.iteration;
+  H5LTset_attribute_long_long(file, "/", "iteration", &iter, 1);
+  H5LTset_attribute_double(file, "/", "dx", &snapshot.dx, 1);
+  H5LTset_attribute_double(file, "/", "dt", &snapshot.dt, 1);
+  H5LTset_attribute_int(file, "/", "numberOfProcessors", &nProcs, 1);
+  H5LTset_attribute_int(file, "/", "processorId", &rank, 1);
+}
+}
+
+void AsyncOutputWriter::writeFluid(OutputSnapshot const & snapshot, std::string const & path, std::string const & iteration) {
+  hid_t file = createFile(path + "/Fluid." + iteration + ".p." + std::to_string(rank) + ".h5");
+  if (file < 0) { return; }
+  writeAttributes(file, snapshot, rank, nProcs);
+  int subdomains = snapshot.nBlocks;
+  H5LTset_attribute_int(file, "/", "numberOfSubdomains", &subdomains, 1);
+
+  for (std::size_t b = 0; b < snapshot.nBlocks; b++) {
+    BlockSnapshot const & block = snapshot.blocks[b];
+    std::string name = "Subdomain_" + std::to_string(b);
+    hid_t group = H5Gcreate2(file, name.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    int position[3] = {(int)block.origin[0], (int)block.origin[1], (int)block.origin[2]};
+    int size[3] = {(int)block.size[0], (int)block.size[1], (int)block.size[2]};
+    long long id = block.id;
+    H5LTset_attribute_int(file, name.c_str(), "relativePosition", position, 3);
+    H5LTset_attribute_int(file, name.c_str(), "subdomainSize", size, 3);
+    H5LTset_attribute_long_long(file, name.c_str(), "blockId", &id, 1);
+
+    for (FieldSnapshot const & f : block.fields) {
+      if (f.values.empty()) { continue; }
+      hsize_t dims[4] = {(hsize_t)size[0], (hsize_t)size[1], (hsize_t)size[2], (hsize_t)f.components};
+      H5LTmake_dataset_float(group, f.name.c_str(), f.components > 1 ? 4 : 3, dims, f.values.data());
+    }
+    H5Gclose(group);
+  }
+
+  H5Fclose(file);
+}
+
+void AsyncOutputWriter::writeCells(OutputSnapshot const & snapshot, ParticleSnapshot const & p, std::string const & path,
+                                   std::string const & iteration) {
+  hid_t file = createFile(path + "/" + p.type + "." + iteration + ".p." + std::to_string(rank) + ".h5");
+  if (file < 0) { return; }
+  writeAttributes(file, snapshot, rank, nProcs);
+  int particles = p.cellId.size(), cells = p.nCells, triangles = p.triangles.size() / 3;
+  H5LTset_attribute_int(file, "/", "numberOfParticles", &particles, 1);
+  H5LTset_attribute_int(file, "/", "numberOfCells", &cells, 1);
+  H5LTset_attribute_int(file, "/", "numberOfTriangles", &triangles, 1);
+
+  hsize_t n = p.cellId.size();
+  if (n > 0) {
+    for (FieldSnapshot const & f : p.fields) {
+      hsize_t dims[2] = {n, (hsize_t)f.components};
+      H5LTmake_dataset_float(file, f.name.c_str(), 2, dims, f.values.data());
+    }
+    if (!p.triangles.empty()) {
+      hsize_t dims[2] = {(hsize_t)triangles, 3};
+      H5LTmake_dataset(file, "triangles", 2, dims, H5T_NATIVE_INT32, p.triangles.data());
+    }
+    H5LTmake_dataset(file, "cellId", 1, &n, H5T_NATIVE_INT64, p.cellId.data());
+    H5LTmake_dataset(file, "vertexId", 1, &n, H5T_NATIVE_INT32, p.vertexId.data());
+  }
+
+  H5Fclose(file);
+}
+
+}
+}
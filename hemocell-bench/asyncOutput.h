@@ -0,0 +1,150 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_ASYNCOUTPUT_H
+#define HEMOCELL_BENCH_ASYNCOUTPUT_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hemo {
+namespace bench {
+
+/* A field of one block (components values per lattice point in x-y-z
+ * order, z fastest) or of the vertices of one cell type (components values
+ * per vertex) */
+struct FieldSnapshot {
+  std::string name;
+  int components = 1;
+  std::vector<float> values;
+};
+
+/* The bulk of one atomic block, in lattice coordinates */
+struct BlockSnapshot {
+  std::int64_t id = 0;
+  std::int64_t origin[3] = {0, 0, 0};
+  std::int64_t size[3] = {0, 0, 0};
+  std::vector<FieldSnapshot> fields;
+};
+
+/* The complete cells of one cell type whose first vertex is in the bulk of this process */
+struct ParticleSnapshot {
+  std::string type;
+  std::size_t nCells = 0;
+  std::vector<FieldSnapshot> fields;
+  /* Three indices into the vertices of this snapshot per triangle, empty without OUTPUT_TRIANGLES */
+  std::vector<std::int32_t> triangles;
+  std::vector<std::int64_t> cellId;
+  std::vector<std::int32_t> vertexId;
+};
+
+/**
+ * Copy of everything written for one output iteration. The vectors keep
+ * their capacity when a snapshot is reused, so after the first outputs
+ * taking a snapshot does not allocate.
+ */
+struct OutputSnapshot {
+  std::int64_t iteration = 0;
+  double dx = 0., dt = 0.;
+  std::size_t nBlocks = 0;
+  std::size_t nParticleTypes = 0;
+  /* Only the first nBlocks and nParticleTypes entries are used */
+  std::vector<BlockSnapshot> blocks;
+  std::vector<ParticleSnapshot> particles;
+
+  /* Mark the snapshot empty, keeping the allocated buffers */
+  void clear();
+  /* Next unused block / particle entry, its vectors are emptied */
+  BlockSnapshot & addBlock();
+  ParticleSnapshot & addParticles();
+  /* Field of the given name in fields, created on first use */
+  static FieldSnapshot & field(std::vector<FieldSnapshot> & fields, std::string const & name, int components);
+};
+
+/**
+ * Writes output snapshots to HDF5 on a background thread, so the solver only
+ * pays for copying the fields into a staging buffer.
+ *
+ * There are `buffers` staging buffers (double buffering by default): while
+ * the writer thread writes one, the next output is copied into another. When
+ * all buffers are still being written acquire() waits, the time spent
+ * waiting is reported by waitSeconds().
+ *
+ * Every process writes the layout of HemoCell's hdf5 output, in
+ * <directory>/hdf5/<iteration>/: Fluid.<iteration>.p.<rank>.h5 with a group
+ * Subdomain_<n> per atomic block (attributes relativePosition, subdomainSize
+ * and blockId, a dataset per field of subdomainSize * components floats) and
+ * <Type>.<iteration>.p.<rank>.h5 per cell type (a dataset per vertex field,
+ * triangles, cellId and vertexId). Only the writer thread calls HDF5, do not
+ * mix this with hemocell.writeOutput().
+ */
+class AsyncOutputWriter {
+public:
+  AsyncOutputWriter(std::string const & directory, int rank, int nProcs, std::size_t buffers = 2);
+  /* Writes the outstanding snapshots */
+  ~AsyncOutputWriter();
+  AsyncOutputWriter(AsyncOutputWriter const &) = delete;
+  AsyncOutputWriter & operator=(AsyncOutputWriter const &) = delete;
+
+  /* A cleared staging buffer, waits if all buffers are being written */
+  OutputSnapshot & acquire();
+  /* Queue the buffer returned by the last acquire() for writing */
+  void submit();
+  /* Wait until every submitted snapshot is written */
+  void flush();
+
+  double waitSeconds() const { return waited; }
+  std::size_t written() const;
+
+private:
+  void run();
+  void write(OutputSnapshot const & snapshot);
+  void writeFluid(OutputSnapshot const & snapshot, std::string const & path, std::string const & iteration);
+  void writeCells(OutputSnapshot const & snapshot, ParticleSnapshot const & p, std::string const & path,
+                  std::string const & iteration);
+
+  std::string directory;
+  int rank;
+  int nProcs;
+
+  std::vector<OutputSnapshot> pool;
+  std::deque<std::size_t> free, queued;
+  std::size_t current;
+  bool busy = false;
+  bool stopping = false;
+  std::size_t nWritten = 0;
+  double waited = 0.;
+
+  mutable std::mutex mutex;
+  std::condition_variable changed;
+  std::thread writer;
+};
+
+}
+}
+#endif
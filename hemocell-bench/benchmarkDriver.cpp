@@ -0,0 +1,660 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "benchmarkDriver.h"
+#include "particleHelpers.h"
+#include "particleLoader.h"
+
+#include "palabos3D.h"
+#include "palabos3D.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <sstream>
+
+#ifdef SCOREP_USER_ENABLE
+#include <scorep/SCOREP_User.h>
+#else // SCOREP_USER_ENABLE
+
+/* **************************************************************************************
+ * Empty macros, if user instrumentation is disabled
+ * *************************************************************************************/
+#define SCOREP_USER_REGION_BEGIN( handle, name, type )
+#define SCOREP_USER_REGION_END( handle )
+#define SCOREP_USER_REGION_DEFINE( handle )
+#define SCOREP_USER_REGION_TYPE_DYNAMIC 1
+
+#endif // SCOREP_USER_ENABLE
+
+namespace hemo {
+namespace bench {
+
+namespace {
+/* The outputs <outputMode> async can copy and their dataset names, as HemoCell writes them */
+const std::map<int, std::string> asyncFluidOutputs = {
+  {OUTPUT_VELOCITY, "Velocity"}, {OUTPUT_DENSITY, "Density"}, {OUTPUT_FORCE, "Force"}, {OUTPUT_BOUNDARY, "Boundary"},
+  {OUTPUT_SHEAR_RATE, "ShearRate"}, {OUTPUT_STRAIN_RATE, "StrainRate"}, {OUTPUT_SHEAR_STRESS, "ShearStress"}};
+const std::map<int, std::string> asyncCellOutputs = {
+  {OUTPUT_POSITION, "position"}, {OUTPUT_TRIANGLES, "triangles"}, {OUTPUT_FORCE, "Total force"},
+  {OUTPUT_FORCE_VOLUME, "Volume force"}, {OUTPUT_FORCE_BENDING, "Bending force"}, {OUTPUT_FORCE_LINK, "Link force"},
+  {OUTPUT_FORCE_AREA, "Area force"}, {OUTPUT_FORCE_VISC, "Viscous force"}};
+
+/* Strain rate of a BGK cell in lattice units, from its deviatoric stress, zero on a boundary */
+plb::Array<T,SymmetricTensor<T,DESCRIPTOR>::n> strainRate(Cell<T,DESCRIPTOR> & cell, bool boundary) {
+  plb::Array<T,SymmetricTensor<T,DESCRIPTOR>::n> S;
+  S.resetToZero();
+  if (boundary) { return S; }
+  T rho = cell.computeDensity();
+  cell.computeDeviatoricStress(S);
+  for (int c = 0; c < SymmetricTensor<T,DESCRIPTOR>::n; c++) {
+    S[c] *= -cell.getDynamics().getOmega() / (2. * rho * DESCRIPTOR<T>::cs2);
+  }
+  return S;
+}
+
+/* Append the position (m) or force (N) of a vertex to values, output one of the vertex fields of asyncCellOutputs */
+void appendVertex(std::vector<float> & values, HemoCellParticle const & particle, int output) {
+  T unit = output == OUTPUT_POSITION ? param::dx : param::df;
+  auto append = [&values, unit](decltype(particle.sv.force) const & v) {
+    values.insert(values.end(), {(float)(v[0] * unit), (float)(v[1] * unit), (float)(v[2] * unit)});
+  };
+  switch (output) {
+  case OUTPUT_POSITION:      append(particle.sv.position); break;
+  case OUTPUT_FORCE:         append(particle.sv.force); break;
+  case OUTPUT_FORCE_VOLUME:  append(*particle.force_volume); break;
+  case OUTPUT_FORCE_BENDING: append(*particle.force_bending); break;
+  case OUTPUT_FORCE_LINK:    append(*particle.force_link); break;
+  case OUTPUT_FORCE_AREA:    append(*particle.force_area); break;
+  case OUTPUT_FORCE_VISC:    append(*particle.force_visc); break;
+  }
+}
+}
+
+BenchmarkDriver::BenchmarkDriver(int argc, char * argv[]) :
+hemocell(argv[1], argc, argv), cfg(hemocell.cfg)
+{
+  tmax = (*cfg)["sim"]["tmax"].read<unsigned int>();
+  tmeas = (*cfg)["sim"]["tmeas"].read<unsigned int>();
+
+  binSize = benchmarkOption<int>("binSize", tmax + 1);
+  hlog << "bin size : " << binSize << endl;
+
+  writeOutputEnabled = benchmarkOption<int>("writeOutput", 1);
+  trebalance = benchmarkOption<unsigned int>("trebalance", tmax + 1);
+
+  // also read without adaptive rebalancing, computeSeconds() sums them
+  std::stringstream timers(benchmarkOption<std::string>("rebalanceTimers",
+      "collideAndStream,spreadParticleForce,interpolateFluidVelocity,advanceParticles,applyConstitutiveModel,applyRepulsionForce"));
+  std::string timer;
+  while (std::getline(timers, timer, ',')) {
+    rebalanceTimers.push_back(timer);
+  }
+
+  std::string rebalancePolicy = benchmarkOption<std::string>("rebalancePolicy", "fixed");
+  if (rebalancePolicy == "adaptive") {
+    adaptiveRebalance.reset(new AdaptiveRebalance(benchmarkOption<unsigned int>("rebalanceCheckEvery", 100),
+                                                  benchmarkOption<unsigned long>("rebalanceHorizon", 1000),
+                                                  benchmarkOption<double>("rebalanceCost", 1.0),
+                                                  benchmarkOption<unsigned int>("rebalancePenaltyIterations", 5)));
+  } else if (rebalancePolicy != "fixed") {
+    hlog << "(main) (Error) unknown rebalance policy \"" << rebalancePolicy << "\", available: fixed adaptive" << endl;
+    exit(1);
+  }
+
+  particleLoader = benchmarkOption<std::string>("particleLoader", "hemocell");
+  if (particleLoader != "hemocell" && particleLoader != "scatter") {
+    hlog << "(main) (Error) unknown particle loader \"" << particleLoader << "\", available: hemocell scatter" << endl;
+    exit(1);
+  }
+
+  outputMode = benchmarkOption<std::string>("outputMode", "hdf5");
+  if (outputMode == "async") {
+    asyncOutput.reset(new AsyncOutputWriter(benchmarkOption<std::string>("outputDirectory", "async-output"),
+                                            plb::global::mpi().getRank(), plb::global::mpi().getSize()));
+  } else if (outputMode != "hdf5" && outputMode != "reduced") {
+    hlog << "(main) (Error) unknown output mode \"" << outputMode << "\", available: hdf5 async reduced" << endl;
+    exit(1);
+  }
+
+  checkpointMode = benchmarkOption<std::string>("checkpointMode", "hemocell");
+  if (checkpointMode != "hemocell" && checkpointMode != "delta") {
+    hlog << "(main) (Error) unknown checkpoint mode \"" << checkpointMode << "\", available: hemocell delta" << endl;
+    exit(1);
+  }
+
+  /* Cycles, instructions, LLC and branch misses per profiler timer, needs -DHEMO_PROFILER_PERF */
+  if (benchmarkOption<int>("hardwareCounters", 0)) {
+    hardwareCounters = hemo::global.statistics.enableCounters();
+  }
+
+  /* Per bin timings of all profiler timers, written to <log>.timeseries */
+  if (benchmarkOption<int>("timeSeries", 0)) {
+    hemo::global.statistics.enableTimeSeries(binSize, benchmarkOption<unsigned int>("timeSeriesLength", 1024));
+  }
+}
+
+int BenchmarkDriver::run() {
+  buildLattice();
+  setupCells();
+  loadCells();
+  beforeLoop();
+
+  hlog << "(main) Starting simulation..." << endl;
+  mainLoop();
+
+  finish();
+
+  hlog << "(main) Simulation finished :) " << endl;
+  return 0;
+}
+
+void BenchmarkDriver::loadCells() {
+  // the lattice and particle fields exist only after setupCells()
+  bool restored = false;
+  if (checkpointMode == "delta") {
+    deltaCheckpoint.reset(new DeltaCheckpoint(hemocell,
+                                              benchmarkOption<std::string>("checkpointDirectory", "delta-checkpoint"),
+                                              benchmarkOption<double>("checkpointTolerance", 0.),
+                                              benchmarkOption<unsigned int>("checkpointBaseEvery", 10)));
+    restored = deltaCheckpoint->restore();
+  }
+
+  if (restored) {
+    hlog << "(main) delta CHECKPOINT restored at iteration " << hemocell.iter << endl;
+  } else if (not cfg->checkpointed) {
+    loadParticles();
+    writeOutput();
+  } else {
+    hlog << "(main) CHECKPOINT found!" << endl;
+    hemocell.loadCheckPoint();
+  }
+
+  if (hemocell.iter == 0) {
+    plint warmup = (*cfg)["parameters"]["warmup"].read<plint>();
+    hlog << "(main) fresh start: warming up cell-free fluid domain for "
+         << warmup << " iterations..." << endl;
+    for (plint itrt = 0; itrt < warmup; ++itrt) {
+      hemocell.lattice->collideAndStream();
+    }
+  }
+}
+
+void BenchmarkDriver::loadParticles() {
+  if (particleLoader == "scatter") {
+    loadParticlesScattered(hemocell, cellTypes);
+  } else {
+    hemocell.loadParticles();
+  }
+}
+
+void BenchmarkDriver::mainLoop() {
+  SCOREP_USER_REGION_DEFINE(my_region)
+  SCOREP_USER_REGION_BEGIN(my_region, "iteration-bin", SCOREP_USER_REGION_TYPE_DYNAMIC)
+
+  throughput.reset(new Throughput(hemocell, cellTypes));
+  if (adaptiveRebalance) { lastComputeSeconds = computeSeconds(); }
+
+  while (hemocell.iter < tmax) {
+    Profiler::HardwareCounters before = {}, after = {};
+    if (hardwareCounters) { before = hemo::global.statistics.readCounters(); }
+    double start = MPI_Wtime();
+    step();
+    double seconds = MPI_Wtime() - start;
+    if (hardwareCounters) { after = hemo::global.statistics.readCounters(); }
+
+    if (adaptiveRebalance) {
+      // only the compute timers, the iteration time includes the waiting for the slowest process
+      double compute = computeSeconds();
+      adaptiveRebalance->addIteration(compute - lastComputeSeconds);
+      lastComputeSeconds = compute;
+    }
+    throughput->addStep(seconds);
+    if (hardwareCounters) {
+      for (int c = 0; c < Profiler::N_COUNTERS; c++) {
+        loopCounters[c] += after[c] - before[c];
+      }
+      loopLatticeUpdates += throughput->latticeNodes();
+    }
+
+    if (hemocell.iter % binSize == 0 && hemocell.iter != 0) {
+      SCOREP_USER_REGION_END(my_region)
+      SCOREP_USER_REGION_BEGIN(my_region, "iteration-bin", SCOREP_USER_REGION_TYPE_DYNAMIC)
+    }
+
+    if (hemocell.iter % tmeas == 0) {
+      printStatistics();
+      writeOutput();
+      throughput->refresh();
+    }
+
+    afterIteration();
+
+    hemo::global.statistics.sample(hemocell.iter);
+  }
+
+  SCOREP_USER_REGION_END(my_region)
+}
+
+void BenchmarkDriver::step() {
+  hemocell.iterate();
+}
+
+void BenchmarkDriver::printStatistics() {
+  if (!statistics) {
+    statistics.reset(new FusedStatistics(hemocell, cellTypes, forceStatistics));
+  }
+  StatisticsSummary const & summary = statistics->compute();
+
+  hlog << "(main) Stats. @ " << hemocell.iter << " ("
+       << hemocell.iter * param::dt << " s):" << endl;
+  hlog << "\t # of cells: " << summary.cells;
+  for (std::size_t i = 0; i < cellTypes.size(); i++) {
+    hlog << (i == 0 ? " | # of " : ", ") << cellTypes[i] << ": " << summary.cellsPerType[i];
+  }
+  hlog << endl;
+
+  T toMpS = param::dx / param::dt;
+  hlog << "\t Velocity  -  max.: " << summary.velocityMax * toMpS
+       << " m/s, mean: " << summary.velocityMean * toMpS
+       << " m/s, rel. app. viscosity: "
+       << (param::u_lbm_max * 0.5) / summary.velocityMean << endl;
+
+  if (forceStatistics) {
+    T topN = param::df * 1.0e12;
+    hlog << "\t Force  -  min.: " << summary.forceMin * topN << " pN, max.: " << summary.forceMax * topN
+         << " pN (" << summary.forceMax << " lf), mean: " << summary.forceMean * topN << " pN" << endl;
+  }
+}
+
+void BenchmarkDriver::afterIteration() {
+  if (adaptiveRebalance) {
+    if (adaptiveRebalance->check(hemocell.iter, tmax - hemocell.iter)) {
+      double start = MPI_Wtime();
+      rebalance();
+      double seconds = MPI_Wtime() - start;
+      MPI_Allreduce(MPI_IN_PLACE, &seconds, 1, MPI_DOUBLE, MPI_MAX, plb::global::mpi().getGlobalCommunicator());
+      adaptiveRebalance->addRebalance(seconds);
+      lastComputeSeconds = computeSeconds();
+    }
+    if (adaptiveRebalance->lastDecision().iteration == hemocell.iter) {
+      RebalanceDecision const & decision = adaptiveRebalance->lastDecision();
+      if (decision.maxIteration == 0. && adaptiveRebalance->checks() == 1) {
+        hlog << "(main) (Warning) none of the <rebalanceTimers> was timed, the adaptive rebalancing never rebalances" << endl;
+      }
+      hlog << "(main) (Rebalance) @ " << hemocell.iter << " iteration max " << decision.maxIteration
+           << " s, mean " << decision.meanIteration << " s, predicted gain " << decision.predictedGain
+           << " s over " << decision.horizon << " iterations, cost " << decision.estimatedCost << " s: "
+           << (decision.rebalance ? "rebalance" : "skip") << endl;
+    }
+  } else if (trebalance > 0 && hemocell.iter > 0 && hemocell.iter % trebalance == 0) {
+    rebalance();
+  }
+}
+
+double BenchmarkDriver::computeSeconds() {
+  double seconds = 0.;
+  for (std::string const & timer : rebalanceTimers) {
+    seconds += hemo::global.statistics.totalSeconds(timer);
+  }
+  return seconds;
+}
+
+void BenchmarkDriver::saveCheckpoint() {
+  if (deltaCheckpoint) {
+    deltaCheckpoint->save();
+  } else {
+    hemocell.saveCheckPoint();
+  }
+}
+
+void BenchmarkDriver::rebalance() {
+  hlog << "(main) doLoadBalance @ " << hemocell.iter << endl;
+  hemocell.loadBalancer->doLoadBalance();
+}
+
+void BenchmarkDriver::finish() {
+  addBlockMetrics();
+  if (throughput && reportThroughput) {
+    throughput->addMetrics();
+  }
+  if (hardwareCounters) {
+    addCounterMetrics();
+  }
+  if (adaptiveRebalance) {
+    hemo::global.statistics.addMetric("Rebalance Checks", (double)adaptiveRebalance->checks());
+    hemo::global.statistics.addMetric("Rebalances", (double)adaptiveRebalance->rebalances());
+    hemo::global.statistics.addMetric("Rebalance Cost", adaptiveRebalance->cost());
+  }
+  if (asyncOutput) {
+    hemo::global.statistics.addMetric("Output Snapshot Time", snapshotSeconds);
+    hemo::global.statistics.addMetric("Output Wait Time", asyncOutput->waitSeconds());
+  }
+  if (deltaCheckpoint) {
+    deltaCheckpoint->flush();
+    hemo::global.statistics.addMetric("Checkpoint Save Time", deltaCheckpoint->saveSeconds());
+    hemo::global.statistics.addMetric("Checkpoint Bytes", deltaCheckpoint->bytesWritten());
+    hemo::global.statistics.addMetric("Checkpoint Blocks Written", deltaCheckpoint->blocksWritten());
+    hemo::global.statistics.addMetric("Checkpoint Blocks Skipped", deltaCheckpoint->blocksSkipped());
+  }
+
+  hemo::global.statistics.printImbalance();
+  hemo::global.statistics.outputTimeSeries();
+  hemo::global.statistics.printStatistics();
+  // 0 leaves the number of MPI-IO aggregators to the MPI library
+  hemo::global.statistics.outputStatistics(benchmarkOption<int>("statisticsAggregators", 0));
+
+  writeOutput();
+  if (asyncOutput) {
+    asyncOutput->flush();
+  }
+}
+
+void BenchmarkDriver::writeOutput() {
+  if (!writeOutputEnabled) { return; }
+
+  if (asyncOutput) {
+    double start = MPI_Wtime();
+    OutputSnapshot & snapshot = asyncOutput->acquire();
+    snapshotOutput(snapshot);
+    asyncOutput->submit();
+    snapshotSeconds += MPI_Wtime() - start;
+  } else if (outputMode == "reduced") {
+    if (!reducedOutput) {
+      reducedOutput.reset(new ReducedOutput(hemocell, cellTypes,
+                                            benchmarkOption<std::string>("outputDirectory", "reduced-output"),
+                                            benchmarkOption<int>("profileBins", 64),
+                                            benchmarkOption<int>("forceBins", 1024),
+                                            std::max(1, benchmarkOption<int>("cellBins", 64)),
+                                            std::max(1, benchmarkOption<int>("cellBinWidth", 1)),
+                                            benchmarkOption<int>("rawCellsPerBlock", 0)));
+    }
+    reducedOutput->write();
+  } else {
+    hemocell.writeOutput();
+  }
+}
+
+void BenchmarkDriver::setOutputs(std::string const & type, std::vector<int> const & outputs) {
+  if (asyncOutput) {
+    for (int output : outputs) {
+      if (!asyncCellOutputs.count(output)) {
+        hlog << "(main) (Error) output " << output << " of " << type << " cannot be written by <outputMode> async, "
+             << "available: OUTPUT_POSITION OUTPUT_TRIANGLES OUTPUT_FORCE OUTPUT_FORCE_VOLUME OUTPUT_FORCE_BENDING "
+             << "OUTPUT_FORCE_LINK OUTPUT_FORCE_AREA OUTPUT_FORCE_VISC" << endl;
+        exit(1);
+      }
+    }
+  }
+  cellOutputs[type] = outputs;
+  hemocell.setOutputs(type, outputs);
+}
+
+void BenchmarkDriver::setFluidOutputs(std::vector<int> const & outputs) {
+  if (asyncOutput) {
+    for (int output : outputs) {
+      if (!asyncFluidOutputs.count(output)) {
+        hlog << "(main) (Error) fluid output " << output << " cannot be written by <outputMode> async, "
+             << "available: OUTPUT_VELOCITY OUTPUT_DENSITY OUTPUT_FORCE OUTPUT_BOUNDARY OUTPUT_SHEAR_RATE "
+             << "OUTPUT_STRAIN_RATE OUTPUT_SHEAR_STRESS" << endl;
+        exit(1);
+      }
+    }
+  }
+  fluidOutputs = outputs;
+  hemocell.setFluidOutputs(outputs);
+}
+
+void BenchmarkDriver::snapshotOutput(OutputSnapshot & snapshot) {
+  snapshot.iteration = hemocell.iter;
+  snapshot.dx = param::dx;
+  snapshot.dt = param::dt;
+  const int nStress = SymmetricTensor<T,DESCRIPTOR>::n;
+
+  // values in SI units: m, s, kg/m^3, N, N/m^3 and Pa
+  const T velocityUnit = param::dx / param::dt;
+  const T forceDensityUnit = param::df / (param::dx * param::dx * param::dx);
+  const T stressUnit = param::df / (param::dx * param::dx);
+
+  MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+  std::vector<plint> const & localBlocks = management.getLocalInfo().getBlocks();
+  for (plint id : localBlocks) {
+    BlockLattice3D<T,DESCRIPTOR> & lattice = hemocell.lattice->getComponent(id);
+    Dot3D location = lattice.getLocation();
+    Box3D bulk = management.getSparseBlockStructure().getBulks().at(id);
+
+    BlockSnapshot & block = snapshot.addBlock();
+    block.id = id;
+    block.origin[0] = bulk.x0; block.origin[1] = bulk.y0; block.origin[2] = bulk.z0;
+    block.size[0] = bulk.getNx(); block.size[1] = bulk.getNy(); block.size[2] = bulk.getNz();
+    // all fields exist before the pointers are taken, creating one may move the others
+    for (int output : fluidOutputs) {
+      int components = output == OUTPUT_VELOCITY || output == OUTPUT_FORCE ? 3 :
+                       output == OUTPUT_STRAIN_RATE || output == OUTPUT_SHEAR_STRESS ? nStress : 1;
+      OutputSnapshot::field(block.fields, asyncFluidOutputs.at(output), components);
+    }
+    std::vector<std::vector<float> *> fields;
+    for (int output : fluidOutputs) {
+      fields.push_back(&OutputSnapshot::field(block.fields, asyncFluidOutputs.at(output), 1).values);
+    }
+
+    for (plint x = bulk.x0; x <= bulk.x1; x++) {
+      for (plint y = bulk.y0; y <= bulk.y1; y++) {
+        for (plint z = bulk.z0; z <= bulk.z1; z++) {
+          Cell<T,DESCRIPTOR> & cell = lattice.get(x - location.x, y - location.y, z - location.z);
+          bool boundary = cell.getDynamics().isBoundary();
+          for (std::size_t i = 0; i < fluidOutputs.size(); i++) {
+            std::vector<float> & values = *fields[i];
+            switch (fluidOutputs[i]) {
+            case OUTPUT_VELOCITY: {
+              plb::Array<T,3> u;
+              cell.computeVelocity(u);
+              values.insert(values.end(), {(float)(u[0] * velocityUnit), (float)(u[1] * velocityUnit), (float)(u[2] * velocityUnit)});
+              break;
+            }
+            case OUTPUT_DENSITY:
+              values.push_back(cell.computeDensity() * param::rho_p);
+              break;
+            case OUTPUT_FORCE: {
+              T * f = cell.getExternal(DESCRIPTOR<T>::ExternalField::forceBeginsAt);
+              values.insert(values.end(), {(float)(f[0] * forceDensityUnit), (float)(f[1] * forceDensityUnit), (float)(f[2] * forceDensityUnit)});
+              break;
+            }
+            case OUTPUT_BOUNDARY:
+              values.push_back(boundary ? 1.f : 0.f);
+              break;
+            case OUTPUT_SHEAR_RATE: {
+              plb::Array<T,SymmetricTensor<T,DESCRIPTOR>::n> S = strainRate(cell, boundary);
+              values.push_back(std::sqrt(2. * SymmetricTensorImpl<T,3>::tensorNormSqr(S)) / param::dt);
+              break;
+            }
+            case OUTPUT_STRAIN_RATE: {
+              plb::Array<T,SymmetricTensor<T,DESCRIPTOR>::n> S = strainRate(cell, boundary);
+              for (int c = 0; c < nStress; c++) { values.push_back(S[c] / param::dt); }
+              break;
+            }
+            case OUTPUT_SHEAR_STRESS: {
+              plb::Array<T,SymmetricTensor<T,DESCRIPTOR>::n> pi;
+              pi.resetToZero();
+              if (!boundary) { cell.computeDeviatoricStress(pi); }
+              for (int c = 0; c < nStress; c++) { values.push_back(pi[c] * stressUnit); }
+              break;
+            }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  /* Complete cells whose first vertex is in the bulk of a local block, like
+   * HemoCell writes them. The other vertices may be in the envelope of that
+   * block, so every cell is written once and its triangles are complete. */
+  std::map<pluint, std::size_t> typeIndex = cellTypeIndex(hemocell, cellTypes);
+  std::vector<plint> nVertices;
+  std::vector<std::vector<int>> vertexOutputs;
+  std::vector<std::vector<std::vector<float> *>> vertexFields;
+  for (std::string const & type : cellTypes) {
+    ParticleSnapshot & p = snapshot.addParticles();
+    p.type = type;
+    nVertices.push_back((*hemocell.cellfields)[type]->numVertex);
+
+    // the positions are always written, the triangles refer to them
+    std::vector<int> outputs = {OUTPUT_POSITION};
+    for (int output : cellOutputs[type]) {
+      if (output != OUTPUT_POSITION && output != OUTPUT_TRIANGLES) { outputs.push_back(output); }
+    }
+    for (int output : outputs) {
+      OutputSnapshot::field(p.fields, asyncCellOutputs.at(output), 3);
+    }
+    vertexFields.emplace_back();
+    for (int output : outputs) {
+      vertexFields.back().push_back(&OutputSnapshot::field(p.fields, asyncCellOutputs.at(output), 3).values);
+    }
+    vertexOutputs.push_back(outputs);
+  }
+
+  for (plint id : localBlocks) {
+    Box3D bulk = management.getSparseBlockStructure().getBulks().at(id);
+    std::map<std::pair<pluint, plint>, std::vector<HemoCellParticle const *>> cells;
+    for (HemoCellParticle const & particle : hemocell.cellfields->immersedParticles->getComponent(id).particles) {
+      auto type = typeIndex.find(particle.sv.celltype);
+      if (type == typeIndex.end()) { continue; }
+      std::vector<HemoCellParticle const *> & vertices = cells[{type->second, particle.sv.cellId}];
+      vertices.resize(nVertices[type->second], nullptr);
+      vertices[particle.sv.vertexId] = &particle;
+    }
+
+    for (auto const & cell : cells) {
+      std::vector<HemoCellParticle const *> const & vertices = cell.second;
+      if (!vertices[0] || !inBulk(bulk, vertices[0]->sv.position)) { continue; }
+      if (std::find(vertices.begin(), vertices.end(), nullptr) != vertices.end()) { continue; }
+
+      std::size_t t = cell.first.first;
+      ParticleSnapshot & p = snapshot.particles[t];
+      std::vector<int> const & triangleOutputs = cellOutputs[cellTypes[t]];
+      if (std::find(triangleOutputs.begin(), triangleOutputs.end(), OUTPUT_TRIANGLES) != triangleOutputs.end()) {
+        std::int32_t offset = p.cellId.size();
+        for (auto const & triangle : (*hemocell.cellfields)[cellTypes[t]]->triangle_list) {
+          p.triangles.insert(p.triangles.end(), {(std::int32_t)(offset + triangle[0]), (std::int32_t)(offset + triangle[1]),
+                                                 (std::int32_t)(offset + triangle[2])});
+        }
+      }
+
+      for (HemoCellParticle const * vertex : vertices) {
+        for (std::size_t i = 0; i < vertexOutputs[t].size(); i++) {
+          appendVertex(*vertexFields[t][i], *vertex, vertexOutputs[t][i]);
+        }
+        p.cellId.push_back(vertex->sv.cellId);
+        p.vertexId.push_back(vertex->sv.vertexId);
+      }
+      p.nCells++;
+    }
+  }
+}
+
+void BenchmarkDriver::addCounterMetrics() {
+  // the memory traffic is estimated as one cache line per LLC miss
+  const double cacheLine = 64.;
+  double cycles = loopCounters[Profiler::CYCLES], instructions = loopCounters[Profiler::INSTRUCTIONS];
+  double llcMisses = loopCounters[Profiler::LLC_MISSES];
+
+  hemo::global.statistics.addMetric("Loop Cycles", cycles);
+  hemo::global.statistics.addMetric("Loop Instructions", instructions);
+  hemo::global.statistics.addMetric("Loop LLC Misses", llcMisses);
+  hemo::global.statistics.addMetric("Loop Branch Misses", (double)loopCounters[Profiler::BRANCH_MISSES]);
+  if (hemo::global.statistics.counterAvailable(Profiler::CYCLES) &&
+      hemo::global.statistics.counterAvailable(Profiler::INSTRUCTIONS) && cycles > 0.) {
+    hemo::global.statistics.addMetric("Loop IPC", instructions / cycles);
+  }
+  if (hemo::global.statistics.counterAvailable(Profiler::LLC_MISSES) && loopLatticeUpdates > 0.) {
+    hemo::global.statistics.addMetric("Loop Bytes Per Lattice Update", llcMisses * cacheLine / loopLatticeUpdates);
+  }
+}
+
+/*
+ * Outputs the neighbouring blocks for this process
+ *
+ * It uses the overlap function, based on the fact that the domain is extended to include the edge lattitice points.
+ * Not very efficiant, but should not have to be run often so probably not a big problem (yet).
+ */
+void BenchmarkDriver::addBlockMetrics() {
+  const std::vector<plint> & blocks = hemocell.lattice->getMultiBlockManagement().getLocalInfo().getBlocks();
+  std::vector<Overlap3D> overlaps = hemocell.lattice->getMultiBlockManagement().getLocalInfo().getNormalOverlaps();
+
+  std::stringstream strings;
+
+  strings << "(";
+  for (const plint & blockId : blocks) {
+    strings << blockId;
+  }
+  strings << ") ";
+
+  for (Overlap3D & overlap : overlaps) {
+    for (const plint & blockId : blocks) {
+      if (overlap.getOriginalId() == blockId) {
+        strings << " " << overlap.getOverlapId();
+        break;
+      }
+    }
+  }
+  hemo::global.statistics.addMetric("neighbours", strings.str());
+
+  // envelope cells this process receives from other processes and the number
+  // of processes they come from, the halo traffic caused by the decomposition
+  ThreadAttribution const & attribution = hemocell.lattice->getMultiBlockManagement().getThreadAttribution();
+  std::vector<Overlap3D> allOverlaps = overlaps;
+  for (PeriodicOverlap3D const & periodic : hemocell.lattice->getMultiBlockManagement().getLocalInfo().getPeriodicOverlaps()) {
+    allOverlaps.push_back(periodic.overlap);
+  }
+
+  double remoteEnvelope = 0;
+  std::set<int> neighbourProcesses;
+  for (Overlap3D & overlap : allOverlaps) {
+    if (attribution.isLocal(overlap.getOriginalId()) && !attribution.isLocal(overlap.getOverlapId())) {
+      remoteEnvelope += overlap.getOriginalCoordinates().nCells();
+      neighbourProcesses.insert(attribution.getMpiProcess(overlap.getOverlapId()));
+    }
+  }
+  hemo::global.statistics.addMetric("Remote Envelope Cells", remoteEnvelope);
+  hemo::global.statistics.addMetric("Neighbour Processes", (double)neighbourProcesses.size());
+
+  int RBCs, size;
+  RBCs = size = 0;
+
+  for (const plint & blockId : blocks) {
+    // Warning: Time measurements will be inaccurate
+    RBCs += hemocell.cellfields->immersedParticles->getComponent(blockId).particles.size();
+    int Nx = hemocell.lattice->getComponent(blockId).getNx();
+    int Ny = hemocell.lattice->getComponent(blockId).getNy();
+    int Nz = hemocell.lattice->getComponent(blockId).getNz();
+    size += Nx * Ny * Nz;
+  }
+
+  hemo::global.statistics.addMetric("RBCs", (double)RBCs);
+  hemo::global.statistics.addMetric("Atomic Block Size", (double)size);
+}
+
+}
+}
@@ -0,0 +1,180 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_BENCHMARKDRIVER_H
+#define HEMOCELL_BENCH_BENCHMARKDRIVER_H
+
+#include "hemocell.h"
+#include "asyncOutput.h"
+#include "deltaCheckpoint.h"
+#include "fusedStatistics.h"
+#include "rebalancePolicy.h"
+#include "reducedOutput.h"
+#include "throughput.h"
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+typedef double T;
+
+namespace hemo {
+namespace bench {
+
+/**
+ * BenchmarkDriver contains everything the benchmarks have in common: reading
+ * the <benchmark> options, the main loop with the Score-P iteration bins and
+ * profiler sampling, the tmeas statistics and output, rebalancing at
+ * trebalance (or when AdaptiveRebalance predicts it pays off, with
+ * <rebalancePolicy> adaptive), the throughput of the steps of the main loop
+ * and the profiler reports at the end.
+ *
+ * A benchmark derives from it and implements the hooks, run() calls them in
+ * this order:
+ *  - buildLattice(): parameters, hemocell.lattice and its boundary conditions
+ *  - setupCells():   cell field, cell types (add them to cellTypes) and outputs
+ *    (with setOutputs() and setFluidOutputs() of the driver)
+ *  - loadCells():    particles or checkpoint, warmup of the fluid
+ *    (the delta checkpoint of <checkpointMode> delta is tried first)
+ *  - beforeLoop()
+ *  - per iteration: step(), printStatistics() and writeOutput() every tmeas
+ *    iterations, afterIteration()
+ *  - finish():       metrics, profiler reports and final output
+ */
+class BenchmarkDriver {
+public:
+  BenchmarkDriver(int argc, char * argv[]);
+  virtual ~BenchmarkDriver() {}
+
+  int run();
+
+protected:
+  virtual void buildLattice() = 0;
+  virtual void setupCells() = 0;
+  virtual void loadCells();
+  /* Fresh start part of loadCells(): create the cells as <particleLoader> says */
+  virtual void loadParticles();
+  virtual void beforeLoop() {}
+  /* A single iteration of the simulation */
+  virtual void step();
+  virtual void printStatistics();
+  /* Called at the end of every iteration, handles trebalance or the adaptive rebalancing */
+  virtual void afterIteration();
+  virtual void rebalance();
+  virtual void finish();
+
+  /* Write hemocell output unless <benchmark><writeOutput> is 0, with
+   * <outputMode> async a snapshot is handed to the background writer, with
+   * reduced only the ReducedOutput statistics are written */
+  void writeOutput();
+  /* Save a checkpoint, the hemocell one or with <checkpointMode> delta a
+   * DeltaCheckpoint generation */
+  void saveCheckpoint();
+  /* hemocell.setOutputs() and hemocell.setFluidOutputs(), the outputs are
+   * remembered for the async output, which stops on outputs it cannot copy */
+  void setOutputs(std::string const & type, std::vector<int> const & outputs);
+  void setFluidOutputs(std::vector<int> const & outputs);
+  /* Copy the configured outputs of the local blocks and the cells of the local particles into snapshot */
+  virtual void snapshotOutput(OutputSnapshot & snapshot);
+  /* Add the neighbour, halo, particle and atomic block size metrics of this process */
+  void addBlockMetrics();
+  /* Add the hardware counter metrics of the main loop (<benchmark><hardwareCounters>) */
+  void addCounterMetrics();
+  /* Seconds this process spent in the <rebalanceTimers> so far, according to the profiler */
+  double computeSeconds();
+
+  /* Read <benchmark><name>, fallback when it is not set */
+  template<typename V>
+  V benchmarkOption(const std::string & name, V fallback) {
+    try {
+      return (*cfg)["benchmark"][name].read<V>();
+    } catch (...) {
+      return fallback;
+    }
+  }
+
+  HemoCell hemocell;
+  Config * cfg;
+
+  /* Cell types as added in setupCells(), used for the statistics. Their
+   * ctypes are only known after it (see cellTypeIndex()), so the statistics,
+   * the throughput and the reduced output are created when first used */
+  std::vector<std::string> cellTypes;
+  /* Also report force statistics every tmeas iterations */
+  bool forceStatistics = false;
+  /* The tmeas statistics, created at the first printStatistics() */
+  std::unique_ptr<FusedStatistics> statistics;
+
+  unsigned int tmax;
+  unsigned int tmeas;
+  unsigned int trebalance;
+  /* Set with <benchmark><rebalancePolicy> adaptive, trebalance is not used then */
+  std::unique_ptr<AdaptiveRebalance> adaptiveRebalance;
+  /* Profiler timers of the computation, whose growth per iteration the adaptive rebalancing compares */
+  std::vector<std::string> rebalanceTimers;
+  double lastComputeSeconds = 0.;
+  int binSize;
+  bool writeOutputEnabled;
+  /* <benchmark><particleLoader>: hemocell (hemocell.loadParticles()) or scatter (loadParticlesScattered()) */
+  std::string particleLoader;
+  /* <benchmark><outputMode>: hdf5, async or reduced */
+  std::string outputMode;
+  std::unique_ptr<AsyncOutputWriter> asyncOutput;
+  std::unique_ptr<ReducedOutput> reducedOutput;
+  /* The outputs of setOutputs() per cell type and of setFluidOutputs() */
+  std::map<std::string, std::vector<int>> cellOutputs;
+  std::vector<int> fluidOutputs;
+  double snapshotSeconds = 0.;
+  /* MLUPS and vertex updates per second of the steps of the main loop, created when it starts */
+  std::unique_ptr<Throughput> throughput;
+  /* Set to false by benchmarks whose step() does not update the lattice */
+  bool reportThroughput = true;
+  /* <benchmark><hardwareCounters>: counters of the steps of the main loop, for all iterations and per lattice update */
+  bool hardwareCounters = false;
+  Profiler::HardwareCounters loopCounters = {};
+  double loopLatticeUpdates = 0.;
+  /* <benchmark><checkpointMode>: hemocell or delta */
+  std::string checkpointMode;
+  std::unique_ptr<DeltaCheckpoint> deltaCheckpoint;
+
+private:
+  void mainLoop();
+};
+
+/* Shared main(): check the arguments, construct the benchmark and run it */
+template<typename Benchmark>
+int runBenchmark(int argc, char * argv[]) {
+  if (argc < 2) {
+    std::cout << "Usage: " << argv[0] << " <configuration.xml>" << std::endl;
+    return -1;
+  }
+
+  Benchmark benchmark(argc, argv);
+  return benchmark.run();
+}
+
+}
+}
+#endif
@@ -0,0 +1,268 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "blockAttribution.h"
+#include "spaceFillingCurve.h"
+#include "../misc/cellPositions.h"
+
+#include <logfile.h>
+#include "parallelism/mpiManager.h"
+#include <mpi.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+
+using namespace plb;
+
+namespace hemo {
+namespace bench {
+
+namespace {
+
+std::vector<plint> idOrder(SparseBlockStructure3D const & blocks) {
+  std::vector<plint> ids;
+  for (auto const & bulk : blocks.getBulks()) {
+    ids.push_back(bulk.first);
+  }
+  return ids;
+}
+
+/* Block ids sorted by the curve position of their centre */
+std::vector<plint> curveOrder(SparseBlockStructure3D const & blocks,
+                              std::uint64_t (*key)(std::uint32_t, std::uint32_t, std::uint32_t, int)) {
+  const int bits = 10;
+  const double cells = (1 << bits) - 1;
+  Box3D bb = blocks.getBoundingBox();
+
+  auto quantize = [cells](plint lo, plint hi, plint origin, plint n) {
+    double centre = 0.5 * (lo + hi) - origin;
+    return (std::uint32_t)std::lround(centre * cells / std::max<plint>(1, n - 1));
+  };
+
+  std::vector<std::pair<std::uint64_t, plint>> keyed;
+  for (auto const & bulk : blocks.getBulks()) {
+    Box3D const & b = bulk.second;
+    keyed.push_back(std::make_pair(key(quantize(b.x0, b.x1, bb.x0, bb.getNx()),
+                                       quantize(b.y0, b.y1, bb.y0, bb.getNy()),
+                                       quantize(b.z0, b.z1, bb.z0, bb.getNz()), bits),
+                                   bulk.first));
+  }
+  std::sort(keyed.begin(), keyed.end());
+
+  std::vector<plint> order;
+  for (auto const & k : keyed) {
+    order.push_back(k.second);
+  }
+  return order;
+}
+
+BlockAttribution contiguous(AttributionInput const & input) {
+  return attributeInOrder(idOrder(input.blocks), input.nProcs);
+}
+
+BlockAttribution roundRobin(AttributionInput const & input) {
+  BlockAttribution attribution;
+  plint i = 0;
+  for (plint id : idOrder(input.blocks)) {
+    attribution[id] = i++ % input.nProcs;
+  }
+  return attribution;
+}
+
+BlockAttribution morton(AttributionInput const & input) {
+  return attributeInOrder(curveOrder(input.blocks, mortonKey), input.nProcs);
+}
+
+BlockAttribution hilbert(AttributionInput const & input) {
+  return attributeInOrder(hilbertOrder(input.blocks), input.nProcs);
+}
+
+BlockAttribution weightedGreedy(AttributionInput const & input) {
+  std::map<plint, double> weights = expectedCellsPerBlock(input.blocks, input.positionFile, input.dx);
+
+  std::vector<plint> ids = idOrder(input.blocks);
+  std::stable_sort(ids.begin(), ids.end(), [&weights](plint a, plint b) {
+    return weights[a] > weights[b];
+  });
+
+  // (load, number of blocks, rank), the number of blocks breaks ties so
+  // blocks without cells are still spread evenly
+  typedef std::tuple<double, plint, plint> Load;
+  std::priority_queue<Load, std::vector<Load>, std::greater<Load>> ranks;
+  for (plint rank = 0; rank < input.nProcs; rank++) {
+    ranks.push(Load(0., 0, rank));
+  }
+
+  BlockAttribution attribution;
+  for (plint id : ids) {
+    Load least = ranks.top();
+    ranks.pop();
+    attribution[id] = std::get<2>(least);
+    ranks.push(Load(std::get<0>(least) + weights[id], std::get<1>(least) + 1, std::get<2>(least)));
+  }
+  return attribution;
+}
+
+BlockAttribution imbalanced(AttributionInput const & input) {
+  std::vector<plint> ids = idOrder(input.blocks);
+  plint nBlocks = ids.size();
+  plint nProcs = input.nProcs;
+
+  if (nBlocks != 2 * nProcs) {
+    hlog << "(BlockAttribution) (Warning) imbalanced expects " << 2 * nProcs
+         << " blocks, got " << nBlocks << std::endl;
+  }
+
+  BlockAttribution attribution;
+  for (plint i = 0; i < (nBlocks - (nProcs / 2)); i += 3) {
+    for (plint j = i; j < std::min(i + 3, nBlocks); j++) {
+      attribution[ids[j]] = (i / 3) % nProcs;
+    }
+  }
+
+  for (plint i = (nBlocks - (nProcs / 2)); i < nBlocks; i++) {
+    attribution[ids[i]] = (i % (nProcs / 2)) + (nProcs / 2);
+  }
+  return attribution;
+}
+
+}
+
+std::map<std::string, AttributionStrategy> & AttributionRegistry::strategies() {
+  static std::map<std::string, AttributionStrategy> registered = {
+    {"contiguous", contiguous},
+    {"roundRobin", roundRobin},
+    {"morton", morton},
+    {"hilbert", hilbert},
+    {"weightedGreedy", weightedGreedy},
+    {"imbalanced", imbalanced},
+  };
+  return registered;
+}
+
+void AttributionRegistry::add(std::string const & name, AttributionStrategy strategy) {
+  strategies()[name] = strategy;
+}
+
+AttributionStrategy const & AttributionRegistry::get(std::string const & name) {
+  auto found = strategies().find(name);
+  if (found == strategies().end()) {
+    hlog << "(BlockAttribution) (Error) unknown attribution \"" << name << "\", available:";
+    for (std::string const & known : names()) {
+      hlog << " " << known;
+    }
+    hlog << std::endl;
+    exit(1);
+  }
+  return found->second;
+}
+
+std::vector<std::string> AttributionRegistry::names() {
+  std::vector<std::string> result;
+  for (auto const & strategy : strategies()) {
+    result.push_back(strategy.first);
+  }
+  return result;
+}
+
+std::map<plint, double> expectedCellsPerBlock(SparseBlockStructure3D const & blocks,
+                                              std::string const & positionFile, double dx) {
+  std::map<plint, double> cells;
+  for (auto const & bulk : blocks.getBulks()) {
+    cells[bulk.first] = 0.;
+  }
+
+  // only rank 0 reads the position file, the counts are broadcast in the
+  // order of the block ids, which is the same on every process
+  std::vector<double> counts(cells.size(), 0.);
+  if (plb::global::mpi().getRank() == 0) {
+    // prefer the binary version of the position file when it exists
+    CellPositions positions;
+    std::string binaryFile = positionFile + "b";
+    try {
+      if (std::ifstream(binaryFile).good()) {
+        positions = PosbFile(binaryFile).all();
+      } else {
+        positions = readPos(positionFile);
+      }
+    } catch (std::runtime_error const & e) {
+      hlog << "(BlockAttribution) (Warning) " << e.what() << ", all blocks get the same weight" << std::endl;
+    }
+
+    for (std::size_t i = 0; i < positions.size(); i++) {
+      plint id = blocks.locate((plint)std::floor(positions.x[i] * 1e-6 / dx),
+                               (plint)std::floor(positions.y[i] * 1e-6 / dx),
+                               (plint)std::floor(positions.z[i] * 1e-6 / dx));
+      if (id >= 0) { cells[id] += 1.; }
+    }
+    std::size_t i = 0;
+    for (auto const & block : cells) {
+      counts[i++] = block.second;
+    }
+  }
+
+  MPI_Bcast(counts.data(), counts.size(), MPI_DOUBLE, 0, plb::global::mpi().getGlobalCommunicator());
+  std::size_t i = 0;
+  for (auto & block : cells) {
+    block.second = counts[i++];
+  }
+  return cells;
+}
+
+std::vector<plint> hilbertOrder(SparseBlockStructure3D const & blocks) {
+  return curveOrder(blocks, hilbertKey);
+}
+
+BlockAttribution attributeInOrder(std::vector<plint> const & order, plint nProcs,
+                                  std::map<plint, double> const & weights) {
+  double total = 0.;
+  for (auto const & w : weights) {
+    total += w.second;
+  }
+
+  BlockAttribution attribution;
+  plint n = order.size();
+  double before = 0.;
+  for (plint i = 0; i < n; i++) {
+    plint rank;
+    if (total > 0.) {
+      // the block goes to the rank whose share contains the middle of its weight
+      auto w = weights.find(order[i]);
+      double weight = w == weights.end() ? 0. : w->second;
+      rank = (plint)((before + 0.5 * weight) * nProcs / total);
+      before += weight;
+    } else {
+      rank = i * nProcs / n;
+    }
+    attribution[order[i]] = std::min(rank, nProcs - 1);
+  }
+  return attribution;
+}
+
+}
+}
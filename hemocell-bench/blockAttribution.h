@@ -0,0 +1,93 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_BLOCKATTRIBUTION_H
+#define HEMOCELL_BENCH_BLOCKATTRIBUTION_H
+
+#include "palabos3D.h"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace hemo {
+namespace bench {
+
+/* Rank of every block id, as passed to ExplicitThreadAttribution */
+typedef std::map<plb::plint, plb::plint> BlockAttribution;
+
+/* Everything a strategy may base the attribution on */
+struct AttributionInput {
+  plb::SparseBlockStructure3D const & blocks;
+  plb::plint nProcs;
+  /* HemoCell .pos file with the initial cell positions (in micrometer) and
+   * the lattice spacing (in meter), used to estimate the work per block */
+  std::string positionFile;
+  double dx;
+};
+
+typedef std::function<BlockAttribution(AttributionInput const &)> AttributionStrategy;
+
+/**
+ * Registry of the block to rank attribution strategies, the cube benchmarks
+ * select one by name with <benchmark><attribution>.
+ *
+ * Built in are:
+ *  - contiguous:     blocks in id order, an equal number per rank
+ *  - roundRobin:     block i to rank i % nProcs
+ *  - morton:         contiguous chunks along the Morton curve through the block centres
+ *  - hilbert:        contiguous chunks along the Hilbert curve through the block centres
+ *  - weightedGreedy: heaviest block first to the least loaded rank, the weight of a
+ *                    block is the number of cells in the position file inside it
+ *  - imbalanced:     triplets to the first half of the ranks and single blocks
+ *                    to the second half (expects 2 * nProcs blocks)
+ */
+class AttributionRegistry {
+public:
+  static void add(std::string const & name, AttributionStrategy strategy);
+  /* Exits with an error listing the known strategies if name is unknown */
+  static AttributionStrategy const & get(std::string const & name);
+  static std::vector<std::string> names();
+
+private:
+  static std::map<std::string, AttributionStrategy> & strategies();
+};
+
+/* Number of cells of the position file (or of its .posb version next to it)
+ * whose centre lies inside each block. Rank 0 reads the file and broadcasts
+ * the counts, collective over the palabos communicator. */
+std::map<plb::plint, double> expectedCellsPerBlock(plb::SparseBlockStructure3D const & blocks,
+                                                   std::string const & positionFile, double dx);
+
+/* Block ids along the Hilbert curve through the block centres */
+std::vector<plb::plint> hilbertOrder(plb::SparseBlockStructure3D const & blocks);
+
+/* Give each rank a contiguous range of `order`, balanced by weight (equal
+ * counts if weights is empty) */
+BlockAttribution attributeInOrder(std::vector<plb::plint> const & order, plb::plint nProcs,
+                                  std::map<plb::plint, double> const & weights = std::map<plb::plint, double>());
+
+}
+}
+#endif
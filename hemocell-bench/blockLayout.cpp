@@ -0,0 +1,145 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "blockLayout.h"
+#include "spaceFillingCurve.h"
+
+#include <logfile.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace plb;
+
+namespace hemo {
+namespace bench {
+
+BlockOrder blockOrderFromString(std::string const & name) {
+  if (name == "xyz") { return BlockOrder::xyz; }
+  if (name == "hilbert") { return BlockOrder::hilbert; }
+
+  hlog << "(BlockLayout) (Error) unknown block layout \"" << name << "\", available: xyz hilbert" << std::endl;
+  exit(1);
+}
+
+std::vector<plint> blockRepartition(Box3D const & domain, plint nBlocks) {
+  std::vector<plint> repartition = algorithm::evenRepartition(nBlocks, 3);
+  std::vector<plint> newRepartition(3);
+  if (domain.getNx() > domain.getNy())
+  { // nx>ny
+    if (domain.getNx() > domain.getNz()) { // nx>nz
+      newRepartition[0] = repartition[0];
+      if (domain.getNy() > domain.getNz()) { // ny>nz
+        newRepartition[1] = repartition[1];
+        newRepartition[2] = repartition[2];
+      }
+      else { // nz>ny
+        newRepartition[1] = repartition[2];
+        newRepartition[2] = repartition[1];
+      }
+    }
+    else { // nz>nx
+      newRepartition[2] = repartition[0];
+      newRepartition[1] = repartition[2];
+      newRepartition[0] = repartition[1];
+    }
+  }
+  else { // ny>nx
+    if (domain.getNy() > domain.getNz()) { // ny>nz
+      newRepartition[1] = repartition[0];
+      if (domain.getNx() > domain.getNz()) { // nx>nz
+        newRepartition[0] = repartition[1];
+        newRepartition[2] = repartition[2];
+      }
+      else { // nz>nx
+        newRepartition[0] = repartition[2];
+        newRepartition[2] = repartition[1];
+      }
+    }
+    else { // nz>ny
+      newRepartition[2] = repartition[0];
+      newRepartition[1] = repartition[1];
+      newRepartition[0] = repartition[2];
+    }
+  }
+  return newRepartition;
+}
+
+void addBlocks(SparseBlockStructure3D & sb,
+               plint ox, plint oy, plint oz,
+               plint nx, plint ny, plint nz,
+               plint numBlocksX, plint numBlocksY, plint numBlocksZ,
+               BlockOrder order) {
+  // the blocks in x-y-z order, the remainder is spread over the first blocks
+  std::vector<Box3D> boxes;
+  std::vector<std::uint64_t> keys;
+
+  int bits = 1;
+  while ((plint(1) << bits) < std::max(numBlocksX, std::max(numBlocksY, numBlocksZ))) { bits++; }
+
+  plint posX = ox;
+  for (plint iBlockX=0; iBlockX<numBlocksX; ++iBlockX) {
+    plint lx = nx / numBlocksX;
+    if (iBlockX < nx % numBlocksX) ++lx;
+    plint posY = oy;
+    for (plint iBlockY=0; iBlockY<numBlocksY; ++iBlockY) {
+      plint ly = ny / numBlocksY;
+      if (iBlockY < ny % numBlocksY) ++ly;
+      plint posZ = oz;
+      for (plint iBlockZ=0; iBlockZ<numBlocksZ; ++iBlockZ) {
+        plint lz = nz / numBlocksZ;
+        if (iBlockZ < nz % numBlocksZ) ++lz;
+        boxes.push_back(Box3D(posX, posX+lx-1, posY, posY+ly-1, posZ, posZ+lz-1));
+        keys.push_back(order == BlockOrder::hilbert ? hilbertKey(iBlockX, iBlockY, iBlockZ, bits) : boxes.size());
+        posZ += lz;
+      }
+      posY += ly;
+    }
+    posX += lx;
+  }
+
+  std::vector<std::size_t> indices(boxes.size());
+  for (std::size_t i = 0; i < indices.size(); i++) { indices[i] = i; }
+  std::sort(indices.begin(), indices.end(), [&keys](std::size_t a, std::size_t b) {
+    return keys[a] < keys[b];
+  });
+
+  for (std::size_t i : indices) {
+    sb.addBlock(boxes[i], sb.nextIncrementalId());
+  }
+}
+
+SparseBlockStructure3D createOrderedDistribution3D(Box3D const & domain, plint nBlocks, BlockOrder order) {
+  if (order == BlockOrder::xyz) {
+    return createRegularDistribution3D(domain, nBlocks);
+  }
+
+  std::vector<plint> repartition = blockRepartition(domain, nBlocks);
+  SparseBlockStructure3D sb(domain);
+  addBlocks(sb, domain.x0, domain.y0, domain.z0, domain.getNx(), domain.getNy(), domain.getNz(),
+            repartition[0], repartition[1], repartition[2], order);
+  return sb;
+}
+
+}
+}
@@ -0,0 +1,66 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_BLOCKLAYOUT_H
+#define HEMOCELL_BENCH_BLOCKLAYOUT_H
+
+#include "palabos3D.h"
+
+#include <string>
+#include <vector>
+
+namespace hemo {
+namespace bench {
+
+/**
+ * Order in which the blocks of a regular decomposition get their ids.
+ *
+ * xyz is the nested x-y-z loop palabos uses, consecutive ids are only
+ * neighbours along z. With hilbert the ids follow the Hilbert curve through
+ * the block grid, so a contiguous range of ids (as given to a process by the
+ * contiguous attribution) is a compact region of the domain.
+ */
+enum class BlockOrder { xyz, hilbert };
+
+/* Parse <benchmark><blockLayout>, exits with an error on unknown names */
+BlockOrder blockOrderFromString(std::string const & name);
+
+/* Number of blocks along x, y and z for nBlocks blocks, the most blocks
+ * along the longest axis (as createRegularDistribution3D) */
+std::vector<plb::plint> blockRepartition(plb::Box3D const & domain, plb::plint nBlocks);
+
+/* Split the box at (ox, oy, oz) of nx * ny * nz lattice points in
+ * numBlocksX * numBlocksY * numBlocksZ blocks and add them to sb, new ids are
+ * handed out in the given order */
+void addBlocks(plb::SparseBlockStructure3D & sb,
+               plb::plint ox, plb::plint oy, plb::plint oz,
+               plb::plint nx, plb::plint ny, plb::plint nz,
+               plb::plint numBlocksX, plb::plint numBlocksY, plb::plint numBlocksZ,
+               BlockOrder order);
+
+/* createRegularDistribution3D with the ids in the given order */
+plb::SparseBlockStructure3D createOrderedDistribution3D(plb::Box3D const & domain, plb::plint nBlocks, BlockOrder order);
+
+}
+}
+#endif
@@ -0,0 +1,314 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "cubeBenchmark.h"
+#include "../misc/cellPositions.h"
+
+#include "cellInfo.h"
+#include "rbcHighOrderModel.h"
+
+#include "palabos3D.h"
+#include "palabos3D.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace hemo {
+namespace bench {
+
+CubeBenchmark::CubeBenchmark(int argc, char * argv[]) : BenchmarkDriver(argc, argv)
+{
+  // number of cells along each axis
+  nx = (*cfg)["domain"]["nx"].read<int>();
+  ny = (*cfg)["domain"]["ny"].read<int>();
+  nz = (*cfg)["domain"]["nz"].read<int>();
+
+  blockOrder = blockOrderFromString(benchmarkOption<std::string>("blockLayout", "xyz"));
+
+  scalingMode = scalingOption<std::string>("mode", "none");
+  if (scalingMode == "weak" || scalingMode == "strong") {
+    scalingDomain();
+  } else if (scalingMode != "none") {
+    hlog << "(main) (Error) unknown scaling mode \"" << scalingMode << "\", available: none weak strong" << endl;
+    exit(1);
+  }
+}
+
+namespace {
+
+/* "x,y,z" as three integers */
+std::vector<plint> readTriple(std::string const & text) {
+  std::vector<plint> values;
+  std::stringstream stream(text);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    values.push_back(std::stol(value));
+  }
+  if (values.size() != 3) {
+    hlog << "(main) (Error) expected x,y,z but got \"" << text << "\"" << endl;
+    exit(1);
+  }
+  return values;
+}
+
+std::vector<plint> primeFactors(plint n) {
+  std::vector<plint> factors;
+  for (plint i = 2; i * i <= n; i++) {
+    while (n % i == 0) {
+      factors.push_back(i);
+      n /= i;
+    }
+  }
+  if (n > 1) { factors.push_back(n); }
+  return factors;
+}
+
+}
+
+void CubeBenchmark::scalingDomain() {
+  const plint nProcs = global::mpi().getSize();
+
+  if (scalingMode == "weak") {
+    std::vector<plint> abSize = readTriple(scalingOption<std::string>("abSize", "25,25,50"));
+    // the largest factors first, each to the axis where the domain is shortest
+    std::vector<plint> primes = primeFactors(nProcs);
+    scalingGrid = {1, 1, 1};
+    for (auto prime = primes.rbegin(); prime != primes.rend(); ++prime) {
+      int axis = 0;
+      for (int d = 1; d < 3; d++) {
+        if (abSize[d] * scalingGrid[d] < abSize[axis] * scalingGrid[axis]) { axis = d; }
+      }
+      scalingGrid[axis] *= *prime;
+    }
+    nx = abSize[0] * scalingGrid[0];
+    ny = abSize[1] * scalingGrid[1];
+    nz = abSize[2] * scalingGrid[2];
+  } else {
+    std::stringstream size;
+    size << nx << "," << ny << "," << nz;
+    std::vector<plint> domain = readTriple(scalingOption<std::string>("size", size.str()));
+    nx = domain[0];
+    ny = domain[1];
+    nz = domain[2];
+    scalingGrid = blockRepartition(Box3D(0, nx - 1, 0, ny - 1, 0, nz - 1), nProcs);
+  }
+
+  hlog << "(main) " << scalingMode << " scaling on " << nProcs << " processes: grid " << scalingGrid[0] << "x"
+       << scalingGrid[1] << "x" << scalingGrid[2] << ", domain " << nx << "x" << ny << "x" << nz << endl;
+  hemo::global.statistics.addMetric("scaling", scalingMode);
+}
+
+MultiBlockManagement3D CubeBenchmark::defaultManagement() {
+  return defaultMultiBlockPolicy3D().getMultiBlockManagement(nx, ny, nz, (*cfg)["domain"]["fluidEnvelope"].read<int>());
+}
+
+void CubeBenchmark::createLattice() {
+  std::string attribution = benchmarkOption<std::string>("attribution", "");
+  if (!scalingGrid.empty()) {
+    // one block per process on the grid of scalingDomain()
+    Box3D domain(0, nx - 1, 0, ny - 1, 0, nz - 1);
+    SparseBlockStructure3D sb(domain);
+    addBlocks(sb, 0, 0, 0, nx, ny, nz, scalingGrid[0], scalingGrid[1], scalingGrid[2], blockOrder);
+    createExplicitLattice(sb, attributeBlocks(sb, "contiguous"));
+  } else if (attribution.empty() && blockOrder == BlockOrder::xyz) {
+    hemocell.initializeLattice(defaultManagement());
+  } else {
+    createAttributedLattice(global::mpi().getSize() * benchmarkOption<int>("blockMultiply", 1), "contiguous");
+  }
+}
+
+void CubeBenchmark::createExplicitLattice(SparseBlockStructure3D const & sb, std::map<plint, plint> const & blockToRank) {
+  MultiBlockManagement3D management = defaultManagement();
+
+  ExplicitThreadAttribution * eta = new ExplicitThreadAttribution(blockToRank);
+  MultiBlockManagement3D * domain_lattice_management = new MultiBlockManagement3D(sb, eta, management.getEnvelopeWidth(), management.getRefinementLevel());
+
+  hemocell.lattice = newLattice(*domain_lattice_management);
+}
+
+MultiBlockLattice3D<T,DESCRIPTOR> * CubeBenchmark::newLattice(MultiBlockManagement3D const & management) {
+  return new MultiBlockLattice3D<T,DESCRIPTOR>(management,
+            defaultMultiBlockPolicy3D().getBlockCommunicator(),
+            defaultMultiBlockPolicy3D().getCombinedStatistics(),
+            defaultMultiBlockPolicy3D().getMultiCellAccess<T, DESCRIPTOR>(),
+            new GuoExternalForceBGKdynamics<T, DESCRIPTOR>(1.0/param::tau));
+}
+
+BlockAttribution CubeBenchmark::attributeBlocks(SparseBlockStructure3D const & sb, std::string const & fallback) {
+  std::string name = benchmarkOption<std::string>("attribution", fallback);
+  hlog << "(main) block attribution: " << name << endl;
+  hemo::global.statistics.addMetric("attribution", name);
+
+  // the initial cell positions are the best estimate of the work per block
+  AttributionInput input{sb, global::mpi().getSize(), "RBC.pos", param::dx};
+  return AttributionRegistry::get(name)(input);
+}
+
+void CubeBenchmark::createAttributedLattice(plint nBlocks, std::string const & fallback) {
+  SparseBlockStructure3D sb = createOrderedDistribution3D(defaultManagement().getBoundingBox(), nBlocks, blockOrder);
+  createExplicitLattice(sb, attributeBlocks(sb, fallback));
+}
+
+void CubeBenchmark::buildLattice() {
+  hlog << "(unbounded) (Parameters) calculating flow parameters" << endl;
+  param::lbm_shear_parameters((*cfg), nz);
+  param::printParameters();
+
+  hlog << "(unbounded) (Fluid) Initializing Palabos Fluid Field" << endl;
+  createLattice();
+
+  hemocell.lattice->toggleInternalStatistics(false);
+
+  // extract sides of the rectangular domain for assignment of boundary
+  // conditions along the outer planes of the domain
+  Box3D top =    Box3D(0,    nx-1, 0,    ny-1, nz-1, nz-1);
+  Box3D bottom = Box3D(0,    nx-1, 0,    ny-1, 0,    0   );
+  Box3D front =  Box3D(0,    nx-1, 0,    0,    0,    nz-1);
+  Box3D back  =  Box3D(0,    nx-1, ny-1, ny-1, 0,    nz-1);
+
+  Box3D left  =  Box3D(0,    0,    0,    ny-1, 0,    nz-1);
+  Box3D right =  Box3D(nx-1, nx-1, 0,    ny-1, 0,    nz-1);
+
+  // no direction has periodicity
+  hemocell.lattice->periodicity().toggleAll(false);
+
+  // bounce back conditions along all sides of the domain
+  defineDynamics(*hemocell.lattice, front,  new BounceBack<T, DESCRIPTOR> );
+  defineDynamics(*hemocell.lattice, back,   new BounceBack<T, DESCRIPTOR> );
+
+  defineDynamics(*hemocell.lattice, left,   new BounceBack<T, DESCRIPTOR> );
+  defineDynamics(*hemocell.lattice, right,  new BounceBack<T, DESCRIPTOR> );
+
+  defineDynamics(*hemocell.lattice, top,    new BounceBack<T, DESCRIPTOR> );
+  defineDynamics(*hemocell.lattice, bottom, new BounceBack<T, DESCRIPTOR> );
+
+  hemocell.latticeEquilibrium(1., plb::Array<T, 3>(0.0, 0.0, 0.0));
+
+  // report basic information regarding the current multi-block configuration
+  hlog << getMultiBlockInfo(*hemocell.lattice) << endl;
+
+  // initialise the lattice
+  hemocell.lattice->initialize();
+}
+
+void CubeBenchmark::setupCells() {
+  // initialise the cells
+  hemocell.initializeCellfield();
+
+  // the desired RBC type
+  hemocell.addCellType<RbcHighOrderModel>("RBC", RBC_FROM_SPHERE);
+  cellTypes.push_back("RBC");
+
+  // define update increments
+  hemocell.setMaterialTimeScaleSeparation(
+      "RBC", (*cfg)["ibm"]["stepMaterialEvery"].read<int>());
+  hemocell.setParticleVelocityUpdateTimeScaleSeparation(
+      (*cfg)["ibm"]["stepParticleEvery"].read<int>());
+
+  // hemocell output fields
+  vector<int> outputs = {OUTPUT_POSITION, OUTPUT_TRIANGLES};
+  setOutputs("RBC", outputs);
+
+  // LBM fluid output fields
+  outputs = {OUTPUT_VELOCITY};
+  setFluidOutputs(outputs);
+}
+
+void CubeBenchmark::loadParticles() {
+  if (scalingMode == "weak") {
+    for (std::string const & type : cellTypes) {
+      checkPositionCoverage(type + ".pos");
+    }
+  }
+  BenchmarkDriver::loadParticles();
+}
+
+void CubeBenchmark::checkPositionCoverage(std::string const & positionFile) {
+  // rank 0 reads the file: the largest centre along every axis, -1 when it cannot be read
+  double extent[3] = {-1., -1., -1.};
+  if (global::mpi().getRank() == 0) {
+    try {
+      CellPositions cells = std::ifstream(positionFile + "b").good() ? PosbFile(positionFile + "b").all()
+                                                                     : readPos(positionFile);
+      extent[0] = extent[1] = extent[2] = 0.;
+      for (std::size_t i = 0; i < cells.size(); i++) {
+        extent[0] = std::max(extent[0], (double)cells.x[i]);
+        extent[1] = std::max(extent[1], (double)cells.y[i]);
+        extent[2] = std::max(extent[2], (double)cells.z[i]);
+      }
+    } catch (std::runtime_error const &) {
+      // the particle loader reports a missing file
+    }
+  }
+  MPI_Bcast(extent, 3, MPI_DOUBLE, 0, global::mpi().getGlobalCommunicator());
+  if (extent[0] < 0.) { return; }
+
+  // a centre within one RBC diameter (8 um) of the far side covers the domain
+  const double diameter = 8.;
+  const double size[3] = {nx * param::dx * 1e6, ny * param::dx * 1e6, nz * param::dx * 1e6};
+  if (extent[0] + diameter < size[0] || extent[1] + diameter < size[1] || extent[2] + diameter < size[2]) {
+    hlog << "(main) (Error) the cells of " << positionFile << " reach " << extent[0] << "x" << extent[1] << "x"
+         << extent[2] << " um, the weak scaling domain is " << size[0] << "x" << size[1] << "x" << size[2]
+         << " um. Generate a position file for the largest domain of the campaign" << endl;
+    exit(1);
+  }
+}
+
+void CubeBenchmark::finish() {
+  // the slowest process decides the time per iteration
+  double perIteration = !scalingGrid.empty() && throughput ? throughput->slowestSecondsPerIteration() : 0.;
+  if (perIteration > 0.) {
+    const double nProcs = global::mpi().getSize();
+    hemo::global.statistics.addMetric("Time Per Iteration", perIteration);
+    hlog << "(main) " << scalingMode << " scaling: " << perIteration << " s per iteration on " << nProcs << " processes";
+
+    double baselineTime = scalingOption<double>("baselineTime", 0.);
+    double baselineProcesses = scalingOption<double>("baselineProcesses", 1.);
+    if (baselineTime > 0.) {
+      // weak: the same time is ideal, strong: the time shrinks with the processes
+      double efficiency = scalingMode == "weak" ? baselineTime / perIteration
+                                                : baselineTime * baselineProcesses / (perIteration * nProcs);
+      hemo::global.statistics.addMetric("Parallel Efficiency", efficiency);
+      hlog << ", parallel efficiency " << efficiency * 100. << " % against " << baselineTime << " s on "
+           << baselineProcesses << " processes" << endl;
+    } else {
+      hlog << ", set <scaling><baselineTime> " << perIteration << " and <baselineProcesses> " << nProcs
+           << " to use this run as the baseline" << endl;
+    }
+  }
+
+  BenchmarkDriver::finish();
+}
+
+void CubeBenchmark::beforeLoop() {
+  int ncells =
+      CellInformationFunctionals::getNumberOfCellsFromType(&hemocell, "RBC");
+  hlog << " | RBC Volume ratio [x100%]: "
+       << ncells * 77.0 * 100 / (nx * ny * nz) << endl;
+  hlog << "(main)   nCells (global) = " << ncells << endl;
+}
+
+}
+}
@@ -0,0 +1,107 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_CUBEBENCHMARK_H
+#define HEMOCELL_BENCH_CUBEBENCHMARK_H
+
+#include "benchmarkDriver.h"
+#include "blockAttribution.h"
+#include "blockLayout.h"
+
+#include <map>
+
+namespace hemo {
+namespace bench {
+
+/**
+ * The cube case: a closed box of nx * ny * nz lattice points (<domain><nx>
+ * etc.) with bounce back on all sides, filled with RBCs.
+ *
+ * The domain decomposition is the only thing the cube benchmarks differ in,
+ * override createLattice() to change it. By default the palabos
+ * decomposition is used, unless <benchmark><attribution> names a strategy of
+ * the AttributionRegistry, then the domain is split in <blockMultiply> blocks
+ * per process and attributed by that strategy. <benchmark><blockLayout>
+ * hilbert numbers these blocks along the Hilbert curve instead of in x-y-z
+ * order (the attribution defaults to contiguous then).
+ *
+ * With <benchmark><scaling><mode> weak or strong the domain is derived from
+ * the number of processes, so one configuration serves a whole scaling
+ * campaign, see scalingDomain(). The time per iteration of the Throughput
+ * is then compared to <scaling><baselineTime> (seconds per iteration on
+ * <scaling><baselineProcesses> processes) as the parallel efficiency. Weak
+ * scaling stops when the position files do not cover the grown domain.
+ */
+class CubeBenchmark : public BenchmarkDriver {
+public:
+  CubeBenchmark(int argc, char * argv[]);
+
+protected:
+  void buildLattice() override;
+  void setupCells() override;
+  void loadParticles() override;
+  void beforeLoop() override;
+  void finish() override;
+
+  /* Create hemocell.lattice, the default is the palabos regular decomposition */
+  virtual void createLattice();
+  /* The management palabos would use for this domain */
+  MultiBlockManagement3D defaultManagement();
+  /* Allocate the lattice for this management, override to use another lattice class */
+  virtual MultiBlockLattice3D<T,DESCRIPTOR> * newLattice(MultiBlockManagement3D const & management);
+  /* Create hemocell.lattice from the given blocks, blockToRank assigns every block to a process */
+  void createExplicitLattice(SparseBlockStructure3D const & sb, std::map<plint, plint> const & blockToRank);
+  /* Attribute the blocks with the strategy named in <benchmark><attribution>, fallback if it is not set */
+  virtual BlockAttribution attributeBlocks(SparseBlockStructure3D const & sb, std::string const & fallback);
+  /* Split the domain regularly in nBlocks blocks, numbered as <blockLayout>, and attribute them with attributeBlocks() */
+  void createAttributedLattice(plint nBlocks, std::string const & fallback);
+
+  /* Set nx, ny, nz and scalingGrid for the scaling mode: weak gives every
+   * process a block of <scaling><abSize> lattice points, the process grid
+   * grows along the shortest axis of the domain. strong splits the domain of
+   * <domain><nx> etc. (or <scaling><size>) over the processes */
+  void scalingDomain();
+  /* Stop when the cells of positionFile do not reach the far sides of the
+   * domain, the rest of the domain would stay empty */
+  void checkPositionCoverage(std::string const & positionFile);
+  /* Read <benchmark><scaling><name>, fallback when it is not set */
+  template<typename V>
+  V scalingOption(const std::string & name, V fallback) {
+    try {
+      return (*cfg)["benchmark"]["scaling"][name].read<V>();
+    } catch (...) {
+      return fallback;
+    }
+  }
+
+  int nx, ny, nz;
+  BlockOrder blockOrder;
+  /* none, weak or strong */
+  std::string scalingMode;
+  /* processes along x, y and z in the scaling mode */
+  std::vector<plint> scalingGrid;
+};
+
+}
+}
+#endif
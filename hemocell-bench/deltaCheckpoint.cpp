@@ -0,0 +1,441 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "deltaCheckpoint.h"
+#include "particleHelpers.h"
+
+#include <logfile.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <dirent.h>
+#include <mpi.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+using namespace plb;
+
+namespace hemo {
+namespace bench {
+
+namespace {
+
+const char MAGIC[8] = {'H', 'C', 'D', 'C', 'K', 'P', 'T', '1'};
+const int PARTICLE_VALUES = 9;
+
+/* Header of a <generation>.p<rank>.ckpt file, followed per block by a
+ * BlockHeader and the compressed, byte shuffled populations and particles */
+struct FileHeader {
+  char magic[8];
+  std::uint32_t rank;
+  std::uint32_t nProcs;
+  std::uint32_t generation;
+  std::uint32_t base;
+  std::int64_t iteration;
+  std::uint64_t nBlocks;
+};
+
+struct BlockHeader {
+  std::int64_t id;
+  std::uint64_t nPopulations;
+  std::uint64_t nParticleValues;
+  std::uint64_t compressedBytes;
+};
+
+/* Group byte i of every double together, the exponent bytes of neighbouring
+ * values are mostly equal and compress well */
+void shuffle(std::vector<double> const & values, std::vector<unsigned char> & out) {
+  const std::size_t n = values.size();
+  out.resize(n * sizeof(double));
+  unsigned char const * bytes = reinterpret_cast<unsigned char const *>(values.data());
+  for (std::size_t i = 0; i < n; i++) {
+    for (std::size_t b = 0; b < sizeof(double); b++) {
+      out[b * n + i] = bytes[i * sizeof(double) + b];
+    }
+  }
+}
+
+void unshuffle(unsigned char const * in, std::size_t n, double * values) {
+  unsigned char * bytes = reinterpret_cast<unsigned char *>(values);
+  for (std::size_t i = 0; i < n; i++) {
+    for (std::size_t b = 0; b < sizeof(double); b++) {
+      bytes[i * sizeof(double) + b] = in[b * n + i];
+    }
+  }
+}
+
+}
+
+DeltaCheckpoint::DeltaCheckpoint(HemoCell & hemocell_, std::string const & directory_,
+                                 double tolerance_, unsigned int baseEvery_) :
+hemocell(hemocell_), directory(directory_), tolerance(tolerance_), baseEvery(std::max(1u, baseEvery_))
+{
+  MPI_Comm_rank(plb::global::mpi().getGlobalCommunicator(), &rank);
+  MPI_Comm_size(plb::global::mpi().getGlobalCommunicator(), &nProcs);
+  if (rank == 0) {
+    mkdir(directory.c_str(), 0755);
+  }
+  MPI_Barrier(plb::global::mpi().getGlobalCommunicator());
+  writer = std::thread(&DeltaCheckpoint::run, this);
+}
+
+DeltaCheckpoint::~DeltaCheckpoint() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  changedState.notify_all();
+  writer.join();
+}
+
+std::string DeltaCheckpoint::filename(std::uint32_t generation, int r) const {
+  char name[64];
+  std::snprintf(name, sizeof(name), "/%08u.p%d.ckpt", generation, r);
+  return directory + name;
+}
+
+double DeltaCheckpoint::bytesWritten() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return nBytes;
+}
+
+void DeltaCheckpoint::copyBlock(plint id, BlockData & data, Fingerprint & fingerprint) {
+  fingerprint.fill(0.);
+  data.id = id;
+
+  BlockLattice3D<T,DESCRIPTOR> & lattice = hemocell.lattice->getComponent(id);
+  Box3D bulk = hemocell.lattice->getMultiBlockManagement().getSparseBlockStructure().getBulks().at(id);
+  Dot3D location = lattice.getLocation();
+  data.populations.clear();
+  for (plint x = bulk.x0; x <= bulk.x1; x++) {
+    for (plint y = bulk.y0; y <= bulk.y1; y++) {
+      for (plint z = bulk.z0; z <= bulk.z1; z++) {
+        Cell<T,DESCRIPTOR> & cell = lattice.get(x - location.x, y - location.y, z - location.z);
+        for (plint i = 0; i < DESCRIPTOR<T>::q; i++) {
+          double f = cell[i];
+          data.populations.push_back(f);
+          fingerprint[0] += f;
+          fingerprint[1] += f * f;
+          fingerprint[2] += f * (i + 1);
+        }
+      }
+    }
+  }
+
+  data.particles.clear();
+  for (HemoCellParticle const & particle : hemocell.cellfields->immersedParticles->getComponent(id).particles) {
+    if (!inBulk(bulk, particle.sv.position)) { continue; }
+
+    Array<T,3> const & p = particle.sv.position;
+
+    Array<T,3> const & v = particle.sv.v;
+    double values[PARTICLE_VALUES] = {p[0], p[1], p[2], v[0], v[1], v[2],
+                                      (double)particle.sv.cellId, (double)particle.sv.vertexId,
+                                      (double)particle.sv.celltype};
+    data.particles.insert(data.particles.end(), values, values + PARTICLE_VALUES);
+    fingerprint[3] += 1.;
+    fingerprint[4] += p[0] + p[1] + p[2];
+    fingerprint[5] += p[0] * p[0] + p[1] * p[1] + p[2] * p[2];
+    fingerprint[6] += v[0] + v[1] + v[2];
+    fingerprint[7] += values[6];
+  }
+}
+
+bool DeltaCheckpoint::changed(Fingerprint const & current, Fingerprint const & last) const {
+  // a different number of particles or cells is always a change
+  if (current[3] != last[3] || current[7] != last[7]) { return true; }
+  for (std::size_t i = 0; i < current.size(); i++) {
+    if (std::fabs(current[i] - last[i]) > tolerance * std::max(std::fabs(last[i]), 1e-300)) { return true; }
+  }
+  return false;
+}
+
+void DeltaCheckpoint::save() {
+  double start = MPI_Wtime();
+
+  // the previous generation must be written before it can be a reference
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    changedState.wait(lock, [this] { return !pending && !busy; });
+  }
+
+  std::unique_ptr<Generation> generation(new Generation());
+  generation->generation = nextGeneration++;
+  generation->iteration = hemocell.iter;
+  bool full = !haveBase || generation->generation - base >= baseEvery;
+  generation->previousBase = haveBase ? base : 0;
+  if (full) {
+    base = generation->generation;
+    haveBase = true;
+  }
+  generation->base = base;
+
+  Fingerprint fingerprint;
+  for (plint id : hemocell.lattice->getMultiBlockManagement().getLocalInfo().getBlocks()) {
+    generation->blocks.emplace_back();
+    copyBlock(id, generation->blocks.back(), fingerprint);
+
+    auto last = written.find(id);
+    if (!full && last != written.end() && !changed(fingerprint, last->second)) {
+      generation->blocks.pop_back();
+      nBlocksSkipped++;
+      continue;
+    }
+    written[id] = fingerprint;
+    nBlocksWritten++;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = std::move(generation);
+  }
+  changedState.notify_all();
+  saveTime += MPI_Wtime() - start;
+}
+
+void DeltaCheckpoint::flush() {
+  std::unique_lock<std::mutex> lock(mutex);
+  changedState.wait(lock, [this] { return !pending && !busy; });
+}
+
+void DeltaCheckpoint::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    changedState.wait(lock, [this] { return stopping || pending; });
+    if (!pending) { return; }
+
+    std::unique_ptr<Generation> generation = std::move(pending);
+    busy = true;
+    lock.unlock();
+    write(*generation);
+    lock.lock();
+    busy = false;
+    changedState.notify_all();
+  }
+}
+
+void DeltaCheckpoint::write(Generation const & generation) {
+  std::string name = filename(generation.generation, rank);
+  std::string temporary = name + ".tmp";
+  std::ofstream out(temporary, std::ios::binary);
+
+  FileHeader header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.rank = rank;
+  header.nProcs = nProcs;
+  header.generation = generation.generation;
+  header.base = generation.base;
+  header.iteration = generation.iteration;
+  header.nBlocks = generation.blocks.size();
+  out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+
+  std::vector<double> values;
+  std::vector<unsigned char> shuffled, compressed;
+  double bytes = sizeof(header);
+  for (BlockData const & block : generation.blocks) {
+    values = block.populations;
+    values.insert(values.end(), block.particles.begin(), block.particles.end());
+    shuffle(values, shuffled);
+
+    uLongf length = compressBound(shuffled.size());
+    compressed.resize(length);
+    int status = compress2(compressed.data(), &length, shuffled.data(), shuffled.size(), Z_BEST_SPEED);
+    if (status != Z_OK) {
+      std::cerr << "(DeltaCheckpoint) (Error) cannot compress block " << block.id << " of " << name
+                << " (zlib error " << status << ")" << std::endl;
+      out.close();
+      std::remove(temporary.c_str());
+      return;
+    }
+
+    BlockHeader blockHeader = {block.id, block.populations.size(), block.particles.size(), length};
+    out.write(reinterpret_cast<char const *>(&blockHeader), sizeof(blockHeader));
+    out.write(reinterpret_cast<char const *>(compressed.data()), length);
+    bytes += sizeof(blockHeader) + length;
+  }
+  out.close();
+
+  if (!out || std::rename(temporary.c_str(), name.c_str()) != 0) {
+    std::cerr << "(DeltaCheckpoint) (Error) cannot write " << name << std::endl;
+    return;
+  }
+
+  // once a new base is complete only the chain of the previous base is
+  // kept, the other processes might not have finished the new base yet
+  if (generation.base == generation.generation) {
+    for (std::uint32_t g : completeGenerations()) {
+      if (g < generation.previousBase) {
+        std::remove(filename(g, rank).c_str());
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  nBytes += bytes;
+}
+
+std::vector<std::uint32_t> DeltaCheckpoint::completeGenerations() const {
+  std::vector<std::uint32_t> generations;
+  DIR * dir = opendir(directory.c_str());
+  if (!dir) { return generations; }
+
+  char suffix[32];
+  std::snprintf(suffix, sizeof(suffix), ".p%d.ckpt", rank);
+  while (dirent * entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    std::size_t length = std::strlen(suffix);
+    if (name.size() > length && name.compare(name.size() - length, length, suffix) == 0) {
+      generations.push_back(std::strtoul(name.c_str(), nullptr, 10));
+    }
+  }
+  closedir(dir);
+  std::sort(generations.begin(), generations.end());
+  return generations;
+}
+
+bool DeltaCheckpoint::restore() {
+  // the newest generation every process has completed
+  std::vector<std::uint32_t> generations = completeGenerations();
+  long newest = generations.empty() ? -1 : (long)generations.back();
+  long common;
+  MPI_Allreduce(&newest, &common, 1, MPI_LONG, MPI_MIN, plb::global::mpi().getGlobalCommunicator());
+  if (common < 0) { return false; }
+
+  // per process: walk back from that generation to its base, the newest copy of a block wins
+  std::map<plint, BlockData> blocks;
+  std::int64_t iteration = 0;
+  std::uint32_t chainBase = common;
+  int failed = 0;
+  for (long g = common; g >= (long)chainBase && !failed; g--) {
+    std::ifstream in(filename(g, rank), std::ios::binary);
+    FileHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || (int)header.nProcs != nProcs) {
+      std::cerr << "(DeltaCheckpoint) (Error) " << filename(g, rank) << " is missing or from another run" << std::endl;
+      failed = 1;
+      break;
+    }
+    if (g == common) {
+      iteration = header.iteration;
+      chainBase = header.base;
+    }
+
+    std::vector<unsigned char> compressed, shuffled;
+    for (std::uint64_t b = 0; b < header.nBlocks; b++) {
+      BlockHeader blockHeader;
+      in.read(reinterpret_cast<char *>(&blockHeader), sizeof(blockHeader));
+      compressed.resize(blockHeader.compressedBytes);
+      in.read(reinterpret_cast<char *>(compressed.data()), compressed.size());
+      if (blocks.count(blockHeader.id)) { continue; }
+
+      std::size_t n = blockHeader.nPopulations + blockHeader.nParticleValues;
+      shuffled.resize(n * sizeof(double));
+      uLongf length = shuffled.size();
+      if (!in || uncompress(shuffled.data(), &length, compressed.data(), compressed.size()) != Z_OK) {
+        std::cerr << "(DeltaCheckpoint) (Error) " << filename(g, rank) << " is corrupt" << std::endl;
+        failed = 1;
+        break;
+      }
+      std::vector<double> values(n);
+      unshuffle(shuffled.data(), n, values.data());
+
+      BlockData & data = blocks[blockHeader.id];
+      data.id = blockHeader.id;
+      data.populations.assign(values.begin(), values.begin() + blockHeader.nPopulations);
+      data.particles.assign(values.begin() + blockHeader.nPopulations, values.end());
+    }
+  }
+
+  // the sizes must match the block, from a different decomposition they do not
+  MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+  std::vector<plint> const & localBlocks = management.getLocalInfo().getBlocks();
+  for (plint id : localBlocks) {
+    auto block = blocks.find(id);
+    if (block == blocks.end()) {
+      std::cerr << "(DeltaCheckpoint) (Error) block " << id << " is not in the checkpoint" << std::endl;
+      failed = 1;
+    } else if (block->second.populations.size() !=
+                   (std::size_t)management.getSparseBlockStructure().getBulks().at(id).nCells() * DESCRIPTOR<T>::q ||
+               block->second.particles.size() % PARTICLE_VALUES != 0) {
+      std::cerr << "(DeltaCheckpoint) (Error) block " << id << " of the checkpoint has " << block->second.populations.size()
+                << " populations and " << block->second.particles.size() << " particle values, which do not fit the block"
+                << std::endl;
+      failed = 1;
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, plb::global::mpi().getGlobalCommunicator());
+  if (failed) {
+    hlog << "(DeltaCheckpoint) (Error) cannot restore generation " << common << std::endl;
+    exit(1);
+  }
+
+  for (plint id : localBlocks) {
+    BlockData const & data = blocks[id];
+
+    BlockLattice3D<T,DESCRIPTOR> & lattice = hemocell.lattice->getComponent(id);
+    Box3D bulk = hemocell.lattice->getMultiBlockManagement().getSparseBlockStructure().getBulks().at(id);
+    Dot3D location = lattice.getLocation();
+    std::size_t i = 0;
+    for (plint x = bulk.x0; x <= bulk.x1; x++) {
+      for (plint y = bulk.y0; y <= bulk.y1; y++) {
+        for (plint z = bulk.z0; z <= bulk.z1; z++) {
+          Cell<T,DESCRIPTOR> & cell = lattice.get(x - location.x, y - location.y, z - location.z);
+          for (plint q = 0; q < DESCRIPTOR<T>::q; q++) {
+            cell[q] = data.populations[i++];
+          }
+        }
+      }
+    }
+
+    HemoCellParticleField & particles = hemocell.cellfields->immersedParticles->getComponent(id);
+    for (std::size_t p = 0; p < data.particles.size(); p += PARTICLE_VALUES) {
+      double const * values = &data.particles[p];
+      HemoCellParticle particle(Array<T,3>(values[0], values[1], values[2]), (plint)values[6], (plint)values[7],
+                                (pluint)values[8]);
+      particle.sv.v = Array<T,3>(values[3], values[4], values[5]);
+      particles.addParticle(&particle);
+    }
+  }
+
+  // envelopes of the lattice and the particle fields
+  hemocell.lattice->duplicateOverlaps(modif::population);
+  hemocell.cellfields->syncEnvelopes();
+  hemocell.cellfields->deleteIncompleteCells();
+  hemocell.iter = iteration;
+
+  // continue the chain with a new base
+  nextGeneration = common + 1;
+  haveBase = false;
+  hlog << "(DeltaCheckpoint) restored generation " << common << " (base " << chainBase
+       << ") at iteration " << iteration << std::endl;
+  return true;
+}
+
+}
+}
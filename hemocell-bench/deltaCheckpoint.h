@@ -0,0 +1,128 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_DELTACHECKPOINT_H
+#define HEMOCELL_BENCH_DELTACHECKPOINT_H
+
+#include "hemocell.h"
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hemo {
+namespace bench {
+
+/**
+ * Differential checkpoints: a checkpoint (generation) only contains the
+ * blocks that changed since they were last written, every baseEvery
+ * generations all blocks are written (a base). The populations and the
+ * bulk particles (position, velocity, ids) of a block are byte shuffled
+ * and compressed with zlib by a background thread, the solver only copies
+ * the changed blocks.
+ *
+ * A block counts as changed when one of its fingerprints (sums over the
+ * populations and particle state, the number of particles) differs
+ * relatively more than tolerance from when it was last written, so with a
+ * tolerance of 0 only blocks that are exactly the same are skipped.
+ *
+ * Every process writes <directory>/<generation>.p<rank>.ckpt (through a
+ * temporary file, so only complete files have this name). restore() picks
+ * the newest generation all processes completed and reads, per process in
+ * parallel, the newest copy of each local block from that generation back
+ * to its base. The files of a chain are removed once the next base is
+ * complete. Restoring needs the same number of processes and decomposition.
+ */
+class DeltaCheckpoint {
+public:
+  DeltaCheckpoint(HemoCell & hemocell, std::string const & directory, double tolerance, unsigned int baseEvery);
+  /* Waits for the outstanding write */
+  ~DeltaCheckpoint();
+
+  /* Copy the changed blocks and hand them to the writer thread, waits if
+   * the previous checkpoint is still being written */
+  void save();
+  /* Collective: restore the newest complete checkpoint, false if there is none */
+  bool restore();
+  /* Wait until the last checkpoint is written */
+  void flush();
+
+  double bytesWritten() const;
+  double blocksWritten() const { return nBlocksWritten; }
+  double blocksSkipped() const { return nBlocksSkipped; }
+  double saveSeconds() const { return saveTime; }
+
+private:
+  struct BlockData {
+    std::int64_t id;
+    std::vector<double> populations;
+    /* position, velocity, cellId, vertexId and celltype per particle */
+    std::vector<double> particles;
+  };
+  struct Generation {
+    std::uint32_t generation;
+    std::uint32_t base;
+    std::uint32_t previousBase;
+    std::int64_t iteration;
+    std::vector<BlockData> blocks;
+  };
+  typedef std::array<double, 8> Fingerprint;
+
+  void copyBlock(plb::plint id, BlockData & data, Fingerprint & fingerprint);
+  bool changed(Fingerprint const & current, Fingerprint const & written) const;
+  void run();
+  void write(Generation const & generation);
+  std::string filename(std::uint32_t generation, int rank) const;
+  std::vector<std::uint32_t> completeGenerations() const;
+
+  HemoCell & hemocell;
+  std::string directory;
+  double tolerance;
+  unsigned int baseEvery;
+  int rank, nProcs;
+
+  std::uint32_t nextGeneration = 0;
+  std::uint32_t base = 0;
+  bool haveBase = false;
+  std::map<plb::plint, Fingerprint> written;
+
+  double nBlocksWritten = 0., nBlocksSkipped = 0., saveTime = 0.;
+  double nBytes = 0.;
+
+  mutable std::mutex mutex;
+  std::condition_variable changedState;
+  std::unique_ptr<Generation> pending;
+  bool busy = false;
+  bool stopping = false;
+  std::thread writer;
+};
+
+}
+}
+#endif
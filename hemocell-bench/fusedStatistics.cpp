@@ -0,0 +1,146 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "fusedStatistics.h"
+#include "particleHelpers.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace plb;
+
+namespace hemo {
+namespace bench {
+
+namespace {
+
+/* Combines whole records (the committed record type of FusedStatistics),
+ * so MPI never splits one. The first element of a record is the number of
+ * entries after it that are summed, the remaining entries are combined with
+ * max (minima are stored negated) */
+void sumThenMax(void * in, void * inout, int * len, MPI_Datatype * type) {
+  int bytes;
+  MPI_Type_size(*type, &bytes);
+  const int size = bytes / sizeof(double);
+  for (int r = 0; r < *len; r++) {
+    double const * a = static_cast<double const *>(in) + r * size;
+    double * b = static_cast<double *>(inout) + r * size;
+    const int nSums = (int)a[0];
+    for (int i = 1; i <= nSums; i++) {
+      b[i] += a[i];
+    }
+    for (int i = nSums + 1; i < size; i++) {
+      b[i] = std::max(a[i], b[i]);
+    }
+  }
+}
+
+// layout of the sums and maxima in the buffer
+enum Sums { FLUID_NODES = 1, VELOCITY_SUM, PARTICLES, FORCE_SUM, CELLS_BEGIN };
+enum Maxima { VELOCITY_MAX, FORCE_MAX, FORCE_MIN_NEGATED, N_MAXIMA };
+
+}
+
+FusedStatistics::FusedStatistics(HemoCell & hemocell_, std::vector<std::string> const & cellTypes, bool forces_) :
+hemocell(hemocell_), forces(forces_), nTypes(cellTypes.size())
+{
+  typeIndex = cellTypeIndex(hemocell, cellTypes);
+  buffer.resize(CELLS_BEGIN + nTypes + N_MAXIMA);
+  summary.cellsPerType.resize(nTypes);
+  MPI_Type_contiguous(buffer.size(), MPI_DOUBLE, &recordType);
+  MPI_Type_commit(&recordType);
+  MPI_Op_create(sumThenMax, 1, &op);
+}
+
+FusedStatistics::~FusedStatistics() {
+  MPI_Op_free(&op);
+  MPI_Type_free(&recordType);
+}
+
+StatisticsSummary const & FusedStatistics::compute() {
+  const std::size_t maxima = CELLS_BEGIN + nTypes;
+  std::fill(buffer.begin(), buffer.end(), 0.);
+  buffer[0] = maxima - 1;
+  buffer[maxima + FORCE_MIN_NEGATED] = -std::numeric_limits<double>::max();
+
+  MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+  std::map<plint, Box3D> const & bulks = management.getSparseBlockStructure().getBulks();
+
+  for (plint id : management.getLocalInfo().getBlocks()) {
+    Box3D const & bulk = bulks.at(id);
+
+    BlockLattice3D<T,DESCRIPTOR> & lattice = hemocell.lattice->getComponent(id);
+    Dot3D location = lattice.getLocation();
+    for (plint x = bulk.x0; x <= bulk.x1; x++) {
+      for (plint y = bulk.y0; y <= bulk.y1; y++) {
+        for (plint z = bulk.z0; z <= bulk.z1; z++) {
+          Cell<T,DESCRIPTOR> & cell = lattice.get(x - location.x, y - location.y, z - location.z);
+          if (cell.getDynamics().isBoundary()) { continue; }
+          Array<T,3> u;
+          cell.computeVelocity(u);
+          double velocity = norm(u);
+          buffer[FLUID_NODES] += 1.;
+          buffer[VELOCITY_SUM] += velocity;
+          buffer[maxima + VELOCITY_MAX] = std::max(buffer[maxima + VELOCITY_MAX], velocity);
+        }
+      }
+    }
+
+    for (HemoCellParticle const & particle : hemocell.cellfields->immersedParticles->getComponent(id).particles) {
+      if (!inBulk(bulk, particle.sv.position)) { continue; }
+
+      if (particle.sv.vertexId == 0) {
+        auto type = typeIndex.find(particle.sv.celltype);
+        if (type != typeIndex.end()) { buffer[CELLS_BEGIN + type->second] += 1.; }
+      }
+      if (forces) {
+        double force = norm(particle.sv.force);
+        buffer[PARTICLES] += 1.;
+        buffer[FORCE_SUM] += force;
+        buffer[maxima + FORCE_MAX] = std::max(buffer[maxima + FORCE_MAX], force);
+        buffer[maxima + FORCE_MIN_NEGATED] = std::max(buffer[maxima + FORCE_MIN_NEGATED], -force);
+      }
+    }
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, buffer.data(), 1, recordType, op, plb::global::mpi().getGlobalCommunicator());
+
+  summary.cells = 0.;
+  for (std::size_t t = 0; t < nTypes; t++) {
+    summary.cellsPerType[t] = buffer[CELLS_BEGIN + t];
+    summary.cells += buffer[CELLS_BEGIN + t];
+  }
+  summary.velocityMax = buffer[maxima + VELOCITY_MAX];
+  summary.velocityMean = buffer[FLUID_NODES] > 0. ? buffer[VELOCITY_SUM] / buffer[FLUID_NODES] : 0.;
+  // without particles the force statistics are zero, not those of an earlier call
+  summary.forceMin = summary.forceMax = summary.forceMean = 0.;
+  if (forces && buffer[PARTICLES] > 0.) {
+    summary.forceMax = buffer[maxima + FORCE_MAX];
+    summary.forceMin = -buffer[maxima + FORCE_MIN_NEGATED];
+    summary.forceMean = buffer[FORCE_SUM] / buffer[PARTICLES];
+  }
+  return summary;
+}
+
+}
+}
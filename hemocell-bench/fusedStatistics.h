@@ -0,0 +1,83 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_FUSEDSTATISTICS_H
+#define HEMOCELL_BENCH_FUSEDSTATISTICS_H
+
+#include "hemocell.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+namespace hemo {
+namespace bench {
+
+/* Global statistics of one FusedStatistics::compute(), in lattice units */
+struct StatisticsSummary {
+  double cells = 0.;
+  std::vector<double> cellsPerType;
+  double velocityMax = 0., velocityMean = 0.;
+  double forceMin = 0., forceMax = 0., forceMean = 0.;
+};
+
+/**
+ * The tmeas statistics in one pass: the number of cells (per type), the
+ * fluid velocity statistics and optionally the particle force statistics
+ * are accumulated while walking the local blocks once, and combined with a
+ * single MPI_Allreduce on one packed buffer. This replaces
+ * getTotalNumberOfCells, getNumberOfCellsFromType per type,
+ * calculateVelocityStatistics and calculateForceStatistics, which each
+ * sweep the blocks and reduce on their own.
+ *
+ * Boundary nodes are left out of the velocity statistics, a cell is counted
+ * in the block whose bulk holds its first vertex. The buffers are allocated
+ * once, compute() does not allocate.
+ */
+class FusedStatistics {
+public:
+  FusedStatistics(HemoCell & hemocell, std::vector<std::string> const & cellTypes, bool forces);
+  ~FusedStatistics();
+
+  /* Collective */
+  StatisticsSummary const & compute();
+
+private:
+  HemoCell & hemocell;
+  bool forces;
+  std::size_t nTypes;
+  std::map<pluint, std::size_t> typeIndex;
+
+  /* [number of sums, sums..., maxima...], see compute() */
+  std::vector<double> buffer;
+  StatisticsSummary summary;
+  /* The whole buffer as one element, reduced with op */
+  MPI_Datatype recordType;
+  MPI_Op op;
+};
+
+}
+}
+#endif
@@ -0,0 +1,179 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "geometryCache.h"
+
+#include <logfile.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <vector>
+
+#include <mpi.h>
+#include <sys/stat.h>
+
+using namespace plb;
+
+namespace hemo {
+namespace bench {
+
+namespace {
+const std::uint64_t FNV_PRIME = 1099511628211ull;
+const char BLOCKS_MAGIC[] = "HCGEOCACHE1";
+
+int worldRank() {
+  int rank;
+  MPI_Comm_rank(plb::global::mpi().getGlobalCommunicator(), &rank);
+  return rank;
+}
+}
+
+std::uint64_t hashString(std::string const & value, std::uint64_t hash) {
+  for (unsigned char c : value) {
+    hash = (hash ^ c) * FNV_PRIME;
+  }
+  return hash;
+}
+
+std::uint64_t hashFile(std::string const & filename) {
+  std::uint64_t hash = 14695981039346656037ull;
+  int failed = 0;
+
+  if (worldRank() == 0) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) {
+      failed = 1;
+    } else {
+      std::vector<char> buffer(1 << 20);
+      while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0) {
+        for (std::streamsize i = 0; i < in.gcount(); i++) {
+          hash = (hash ^ (unsigned char)buffer[i]) * FNV_PRIME;
+        }
+      }
+    }
+  }
+
+  MPI_Bcast(&failed, 1, MPI_INT, 0, plb::global::mpi().getGlobalCommunicator());
+  if (failed) {
+    hlog << "(GeometryCache) (Error) cannot read " << filename << std::endl;
+    exit(1);
+  }
+  MPI_Bcast(&hash, 1, MPI_UINT64_T, 0, plb::global::mpi().getGlobalCommunicator());
+  return hash;
+}
+
+GeometryCache::GeometryCache(std::string const & directory_, std::string const & key_) :
+directory(directory_), key(key_)
+{
+  if (worldRank() == 0) {
+    mkdir(directory.c_str(), 0755);
+  }
+}
+
+std::string GeometryCache::blocksFile() const {
+  return directory + "/" + key + ".blocks";
+}
+
+std::string GeometryCache::flagsFile() const {
+  return directory + "/" + key + ".flags";
+}
+
+bool GeometryCache::exists() const {
+  int found = 0;
+  if (worldRank() == 0) {
+    found = std::ifstream(blocksFile()).good();
+  }
+  MPI_Bcast(&found, 1, MPI_INT, 0, plb::global::mpi().getGlobalCommunicator());
+  return found;
+}
+
+void GeometryCache::load(std::unique_ptr<MultiBlockManagement3D> & management,
+                         std::unique_ptr<MultiScalarField3D<int>> & flagMatrix) const {
+  // the block structure is small, rank 0 reads and broadcasts it
+  std::vector<long> data;
+  if (worldRank() == 0) {
+    std::ifstream in(blocksFile());
+    std::string magic;
+    in >> magic;
+    long value;
+    while (in >> value) {
+      data.push_back(value);
+    }
+    if (magic != BLOCKS_MAGIC) {
+      data.clear();
+    }
+  }
+
+  long size = data.size();
+  MPI_Bcast(&size, 1, MPI_LONG, 0, plb::global::mpi().getGlobalCommunicator());
+  data.resize(size);
+  MPI_Bcast(data.data(), size, MPI_LONG, 0, plb::global::mpi().getGlobalCommunicator());
+
+  // envelope width, refinement level, bounding box, number of blocks, then
+  // id, bulk and process of every block
+  if (size < 9 || size != 9 + 8 * data[8]) {
+    hlog << "(GeometryCache) (Error) " << blocksFile() << " is corrupt, remove it to voxelize again" << std::endl;
+    exit(1);
+  }
+
+  SparseBlockStructure3D blocks(Box3D(data[2], data[3], data[4], data[5], data[6], data[7]));
+  std::map<plint, plint> attribution;
+  for (long i = 9; i < size; i += 8) {
+    blocks.addBlock(Box3D(data[i + 1], data[i + 2], data[i + 3], data[i + 4], data[i + 5], data[i + 6]), data[i]);
+    attribution[data[i]] = data[i + 7];
+  }
+
+  management.reset(new MultiBlockManagement3D(blocks, new ExplicitThreadAttribution(attribution), data[0], data[1]));
+  flagMatrix.reset(new MultiScalarField3D<int>(*management,
+                                               defaultMultiBlockPolicy3D().getBlockCommunicator(),
+                                               defaultMultiBlockPolicy3D().getCombinedStatistics(),
+                                               defaultMultiBlockPolicy3D().getMultiScalarAccess<int>()));
+  parallelIO::load(flagsFile(), *flagMatrix, false);
+}
+
+void GeometryCache::store(MultiBlockManagement3D const & management, MultiScalarField3D<int> & flagMatrix) const {
+  parallelIO::save(flagMatrix, flagsFile(), false);
+  MPI_Barrier(plb::global::mpi().getGlobalCommunicator());
+
+  if (worldRank() == 0) {
+    SparseBlockStructure3D const & blocks = management.getSparseBlockStructure();
+    ThreadAttribution const & attribution = management.getThreadAttribution();
+    Box3D bb = blocks.getBoundingBox();
+
+    std::ofstream out(blocksFile());
+    out << BLOCKS_MAGIC << "\n"
+        << management.getEnvelopeWidth() << " " << management.getRefinementLevel() << "\n"
+        << bb.x0 << " " << bb.x1 << " " << bb.y0 << " " << bb.y1 << " " << bb.z0 << " " << bb.z1 << "\n"
+        << blocks.getBulks().size() << "\n";
+    for (auto const & bulk : blocks.getBulks()) {
+      Box3D const & b = bulk.second;
+      out << bulk.first << " " << b.x0 << " " << b.x1 << " " << b.y0 << " " << b.y1 << " " << b.z0 << " " << b.z1
+          << " " << attribution.getMpiProcess(bulk.first) << "\n";
+    }
+  }
+  MPI_Barrier(plb::global::mpi().getGlobalCommunicator());
+}
+
+}
+}
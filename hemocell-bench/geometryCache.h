@@ -0,0 +1,79 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_GEOMETRYCACHE_H
+#define HEMOCELL_BENCH_GEOMETRYCACHE_H
+
+#include "palabos3D.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace hemo {
+namespace bench {
+
+/**
+ * On disk cache of a voxelized geometry: the flag matrix and the block
+ * management it was created with.
+ *
+ * An entry is stored as <directory>/<key>.blocks, the block structure and
+ * the process of every block written by rank 0, and <directory>/<key>.flags
+ * (.dat/.plb), the flag matrix written with palabos parallelIO so every
+ * process reads back only its own blocks. The .blocks file is written last,
+ * an entry without it is incomplete and ignored.
+ */
+class GeometryCache {
+public:
+  /* directory is created by rank 0 if it does not exist */
+  GeometryCache(std::string const & directory, std::string const & key);
+
+  /* Collective: true if a complete entry for the key exists */
+  bool exists() const;
+
+  /* Collective: the cached management (blocks are mapped to the same
+   * processes as when it was stored) and the flag matrix on it */
+  void load(std::unique_ptr<plb::MultiBlockManagement3D> & management,
+            std::unique_ptr<plb::MultiScalarField3D<int>> & flagMatrix) const;
+
+  /* Collective: store the management and flag matrix under the key */
+  void store(plb::MultiBlockManagement3D const & management, plb::MultiScalarField3D<int> & flagMatrix) const;
+
+private:
+  std::string blocksFile() const;
+  std::string flagsFile() const;
+
+  std::string directory;
+  std::string key;
+};
+
+/* FNV-1a hash of the contents of a file, read by rank 0 and broadcast,
+ * exits with an error if the file cannot be read */
+std::uint64_t hashFile(std::string const & filename);
+
+/* FNV-1a hash of a string, continuing from hash */
+std::uint64_t hashString(std::string const & value, std::uint64_t hash = 14695981039346656037ull);
+
+}
+}
+#endif
@@ -0,0 +1,60 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_PARTICLEHELPERS_H
+#define HEMOCELL_BENCH_PARTICLEHELPERS_H
+
+#include "hemocell.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace hemo {
+namespace bench {
+
+/* Whether a particle at this position belongs to the bulk of a block, so
+ * the envelope copies of other blocks are left out. The position is rounded
+ * to the nearest lattice node. */
+inline bool inBulk(plb::Box3D const & bulk, plb::Array<T,3> const & position) {
+  plb::plint x = plb::util::roundToInt(position[0]);
+  plb::plint y = plb::util::roundToInt(position[1]);
+  plb::plint z = plb::util::roundToInt(position[2]);
+  return x >= bulk.x0 && x <= bulk.x1 && y >= bulk.y0 && y <= bulk.y1 && z >= bulk.z0 && z <= bulk.z1;
+}
+
+/* Position in cellTypes of every ctype (HemoCellParticle::sv.celltype).
+ * The ctypes are only known after the cell types are added, in the
+ * setupCells() of a benchmark, so everything that needs this map is
+ * created after it. */
+inline std::map<plb::pluint, std::size_t> cellTypeIndex(HemoCell & hemocell, std::vector<std::string> const & cellTypes) {
+  std::map<plb::pluint, std::size_t> index;
+  for (std::size_t i = 0; i < cellTypes.size(); i++) {
+    index[(*hemocell.cellfields)[cellTypes[i]]->ctype] = i;
+  }
+  return index;
+}
+
+}
+}
+#endif
@@ -0,0 +1,404 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "particleLoader.h"
+
+#include <logfile.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <set>
+#include <stdexcept>
+
+#include <mpi.h>
+
+using namespace plb;
+
+namespace hemo {
+namespace bench {
+
+namespace {
+
+/* A cell as sent to the process owning the block */
+struct CellRecord {
+  std::int64_t block;
+  float x, y, z;
+  float rx, ry, rz;
+  std::uint32_t id;
+};
+
+/* The position file of the node reader, the .posb version is preferred */
+class PositionSource {
+public:
+  explicit PositionSource(std::string const & positionFile) {
+    std::string binaryFile = positionFile + "b";
+    if (std::ifstream(binaryFile).good()) {
+      binary.reset(new PosbFile(binaryFile));
+    } else {
+      text = readPos(positionFile);
+    }
+  }
+
+  std::size_t size() const { return binary ? binary->size() : text.size(); }
+
+  CellPositions select(float const lo[3], float const hi[3]) const {
+    if (binary) { return binary->select(lo, hi); }
+
+    CellPositions out;
+    for (std::size_t i = 0; i < text.size(); i++) {
+      if (text.x[i] >= lo[0] && text.x[i] <= hi[0] && text.y[i] >= lo[1] && text.y[i] <= hi[1] &&
+          text.z[i] >= lo[2] && text.z[i] <= hi[2]) {
+        out.push_back(text.x[i], text.y[i], text.z[i], text.rx[i], text.ry[i], text.rz[i], text.id[i]);
+      }
+    }
+    return out;
+  }
+
+private:
+  std::unique_ptr<PosbFile> binary;
+  CellPositions text;
+};
+
+/* The cell centres a block holds, from x0 up to x1 + 1 (as locate()), widened by margin */
+void blockBounds(Box3D const & box, double dx, double margin, float lo[3], float hi[3]) {
+  const double toMicrometer = dx * 1e6;
+  lo[0] = float((box.x0 - margin) * toMicrometer);
+  lo[1] = float((box.y0 - margin) * toMicrometer);
+  lo[2] = float((box.z0 - margin) * toMicrometer);
+  hi[0] = float((box.x1 + 1 + margin) * toMicrometer);
+  hi[1] = float((box.y1 + 1 + margin) * toMicrometer);
+  hi[2] = float((box.z1 + 1 + margin) * toMicrometer);
+}
+
+}
+
+ScatteredCells scatterCellPositions(MultiBlockManagement3D const & management,
+                                    std::string const & positionFile, double dx, double margin) {
+  int rank;
+  MPI_Comm_rank(plb::global::mpi().getGlobalCommunicator(), &rank);
+
+  MPI_Comm node;
+  MPI_Comm_split_type(plb::global::mpi().getGlobalCommunicator(), MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+  int nodeRank, nodeSize;
+  MPI_Comm_rank(node, &nodeRank);
+  MPI_Comm_size(node, &nodeSize);
+
+  std::vector<int> nodeProcesses(nodeSize);
+  MPI_Gather(&rank, 1, MPI_INT, nodeProcesses.data(), 1, MPI_INT, 0, node);
+
+  // the node reader selects the cells of every block of its node, every
+  // process knows the complete block distribution so nothing else is exchanged
+  std::vector<CellRecord> records;
+  std::vector<int> counts(nodeSize, 0), displacements(nodeSize, 0);
+  unsigned long long total = 0;
+  int failed = 0;
+
+  if (nodeRank == 0) {
+    try {
+      PositionSource source(positionFile);
+      total = source.size();
+
+      std::map<int, int> nodeRanks;
+      for (int i = 0; i < nodeSize; i++) {
+        nodeRanks[nodeProcesses[i]] = i;
+      }
+
+      std::vector<std::vector<CellRecord>> perProcess(nodeSize);
+      ThreadAttribution const & attribution = management.getThreadAttribution();
+      for (auto const & bulk : management.getSparseBlockStructure().getBulks()) {
+        auto target = nodeRanks.find(attribution.getMpiProcess(bulk.first));
+        if (target == nodeRanks.end()) { continue; }
+
+        float lo[3], hi[3];
+        blockBounds(bulk.second, dx, margin, lo, hi);
+        CellPositions cells = source.select(lo, hi);
+        for (std::size_t i = 0; i < cells.size(); i++) {
+          perProcess[target->second].push_back(CellRecord{bulk.first, cells.x[i], cells.y[i], cells.z[i],
+                                                          cells.rx[i], cells.ry[i], cells.rz[i], cells.id[i]});
+        }
+      }
+
+      for (int i = 0; i < nodeSize; i++) {
+        counts[i] = perProcess[i].size() * sizeof(CellRecord);
+        displacements[i] = records.size() * sizeof(CellRecord);
+        records.insert(records.end(), perProcess[i].begin(), perProcess[i].end());
+      }
+    } catch (std::runtime_error const & e) {
+      hlog << "(ParticleLoader) (Error) " << e.what() << std::endl;
+      failed = 1;
+    }
+  }
+
+  MPI_Bcast(&failed, 1, MPI_INT, 0, node);
+  if (failed) {
+    MPI_Abort(plb::global::mpi().getGlobalCommunicator(), 1);
+  }
+
+  int count;
+  MPI_Scatter(counts.data(), 1, MPI_INT, &count, 1, MPI_INT, 0, node);
+  std::vector<CellRecord> mine(count / sizeof(CellRecord));
+  MPI_Scatterv(records.data(), counts.data(), displacements.data(), MPI_BYTE,
+               mine.data(), count, MPI_BYTE, 0, node);
+  MPI_Bcast(&total, 1, MPI_UNSIGNED_LONG_LONG, 0, node);
+  MPI_Comm_free(&node);
+
+  ScatteredCells result;
+  result.total = total;
+  for (CellRecord const & cell : mine) {
+    result.blocks[cell.block].push_back(cell.x, cell.y, cell.z, cell.rx, cell.ry, cell.rz, cell.id);
+  }
+  return result;
+}
+
+ScatteredCells selectCellPositions(MultiBlockManagement3D const & management,
+                                   CellPositions const & cells, double dx, double margin) {
+  ScatteredCells result;
+  result.total = cells.size();
+  for (plint id : management.getLocalInfo().getBlocks()) {
+    float lo[3], hi[3];
+    blockBounds(management.getSparseBlockStructure().getBulks().at(id), dx, margin, lo, hi);
+    for (std::size_t i = 0; i < cells.size(); i++) {
+      if (cells.x[i] >= lo[0] && cells.x[i] <= hi[0] && cells.y[i] >= lo[1] && cells.y[i] <= hi[1] &&
+          cells.z[i] >= lo[2] && cells.z[i] <= hi[2]) {
+        result.blocks[id].push_back(cells.x[i], cells.y[i], cells.z[i], cells.rx[i], cells.ry[i], cells.rz[i], cells.id[i]);
+      }
+    }
+  }
+  return result;
+}
+
+namespace {
+
+/* The rotation of TriangularSurfaceMesh<T>::rotate(phi, theta, psi), Euler
+ * angles in the x-convention, which HemoCell's meshRotation() applies to the
+ * angles (degrees) of the .pos file in loadParticles() */
+void rotationMatrix(float rx, float ry, float rz, T m[3][3]) {
+  const T toRadians = M_PI / 180.;
+  T phi = rx * toRadians, theta = ry * toRadians, psi = rz * toRadians;
+  T cosPhi = std::cos(phi), sinPhi = std::sin(phi), cosTheta = std::cos(theta), sinTheta = std::sin(theta);
+  T cosPsi = std::cos(psi), sinPsi = std::sin(psi);
+  m[0][0] = cosPsi * cosPhi - cosTheta * sinPhi * sinPsi;
+  m[0][1] = cosPsi * sinPhi + cosTheta * cosPhi * sinPsi;
+  m[0][2] = sinPsi * sinTheta;
+  m[1][0] = -sinPsi * cosPhi - cosTheta * sinPhi * cosPsi;
+  m[1][1] = -sinPsi * sinPhi + cosTheta * cosPhi * cosPsi;
+  m[1][2] = cosPsi * sinTheta;
+  m[2][0] = sinTheta * sinPhi;
+  m[2][1] = -sinTheta * cosPhi;
+  m[2][2] = cosTheta;
+}
+
+/* Vertices of cell i of positions: shape rotated by its angles around the centre, moved to its position */
+void placeCell(CellPositions const & positions, std::size_t i, std::vector<Array<T, 3>> const & shape,
+               std::vector<Array<T, 3>> & vertices) {
+  const T toLattice = 1e-6 / param::dx;
+  T rotation[3][3];
+  rotationMatrix(positions.rx[i], positions.ry[i], positions.rz[i], rotation);
+  Array<T, 3> centre(positions.x[i] * toLattice, positions.y[i] * toLattice, positions.z[i] * toLattice);
+
+  vertices.clear();
+  for (Array<T, 3> const & v : shape) {
+    Array<T, 3> vertex;
+    for (int d = 0; d < 3; d++) {
+      vertex[d] = centre[d] + rotation[d][0] * v[0] + rotation[d][1] * v[1] + rotation[d][2] * v[2];
+    }
+    vertices.push_back(vertex);
+  }
+}
+
+/* Ids of the cells that every process rejected, collective over the palabos communicator */
+std::set<std::uint32_t> gatherRejected(std::vector<std::uint32_t> const & rejected) {
+  MPI_Comm comm = plb::global::mpi().getGlobalCommunicator();
+  int size;
+  MPI_Comm_size(comm, &size);
+
+  int count = rejected.size();
+  std::vector<int> counts(size), displacements(size, 0);
+  MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, comm);
+  for (int i = 1; i < size; i++) {
+    displacements[i] = displacements[i - 1] + counts[i - 1];
+  }
+  std::vector<std::uint32_t> all(displacements[size - 1] + counts[size - 1]);
+  MPI_Allgatherv(rejected.data(), count, MPI_UINT32_T, all.data(), counts.data(), displacements.data(),
+                 MPI_UINT32_T, comm);
+  return std::set<std::uint32_t>(all.begin(), all.end());
+}
+
+/* The part of loadParticlesScattered() after the positions: cellsOf(type, margin) gives the cells of a type per local block */
+void createCells(HemoCell & hemocell, std::vector<std::string> const & cellTypes, Box3D const * region,
+                 std::function<ScatteredCells(std::size_t, double)> const & cellsOf) {
+  double start = MPI_Wtime();
+
+  MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+  std::vector<plint> const & localBlocks = management.getLocalInfo().getBlocks();
+  const T toLattice = 1e-6 / param::dx;
+
+  // mesh vertices relative to the centre of the bounding box of the mesh, as
+  // meshRotation() rotates them, the largest radius decides how far outside
+  // a block a cell can still reach into it
+  std::vector<std::vector<Array<T, 3>>> shapes(cellTypes.size());
+  T radius = 0., minimumDistance = 0.;
+  for (std::size_t type = 0; type < cellTypes.size(); type++) {
+    TriangularSurfaceMesh<T> * mesh = (*hemocell.cellfields)[cellTypes[type]]->getMesh();
+    Array<T, 2> xRange, yRange, zRange;
+    mesh->computeBoundingBox(xRange, yRange, zRange);
+    Array<T, 3> centre((xRange[0] + xRange[1]) * 0.5, (yRange[0] + yRange[1]) * 0.5, (zRange[0] + zRange[1]) * 0.5);
+    for (plint k = 0; k < mesh->getNumVertices(); k++) {
+      Array<T, 3> vertex = mesh->getVertex(k) - centre;
+      shapes[type].push_back(vertex);
+      radius = std::max(radius, norm(vertex));
+    }
+    minimumDistance = std::max(minimumDistance, (*hemocell.cellfields)[cellTypes[type]]->minimumDistanceFromSolid * toLattice);
+  }
+  // every process whose bulk holds a node within the minimum distance of a vertex also gets the cell
+  const double margin = (*hemocell.cfg)["domain"]["particleEnvelope"].read<double>() + radius + minimumDistance;
+
+  std::size_t offset = 0, created = 0, skipped = 0;
+  std::vector<Array<T, 3>> vertices;
+  for (std::size_t type = 0; type < cellTypes.size(); type++) {
+    ScatteredCells cells = cellsOf(type, margin);
+    const pluint ctype = (*hemocell.cellfields)[cellTypes[type]]->ctype;
+    // as setInitialMinimumDistanceFromSolid(), a vertex is never closer to a solid node than this
+    const T distance = (*hemocell.cellfields)[cellTypes[type]]->minimumDistanceFromSolid * toLattice;
+    const plint reach = std::ceil(distance);
+
+    auto inRegion = [region, toLattice](CellPositions const & positions, std::size_t i) {
+      if (!region) { return true; }
+      T x = positions.x[i] * toLattice, y = positions.y[i] * toLattice, z = positions.z[i] * toLattice;
+      return x >= region->x0 && x <= region->x1 && y >= region->y0 && y <= region->y1 && z >= region->z0 && z <= region->z1;
+    };
+
+    // every process tests the cells against the solid nodes in the bulk of
+    // its blocks only, so together they decide once per cell, for every
+    // block that holds a copy of it
+    std::vector<std::uint32_t> rejected;
+    for (plint blockId : localBlocks) {
+      auto found = cells.blocks.find(blockId);
+      if (found == cells.blocks.end()) { continue; }
+      CellPositions const & positions = found->second;
+
+      BlockLattice3D<T, DESCRIPTOR> & fluid = hemocell.lattice->getComponent(blockId);
+      Dot3D location = fluid.getLocation();
+      Box3D bulk = management.getSparseBlockStructure().getBulks().at(blockId);
+      auto tooClose = [&](Array<T, 3> const & vertex) {
+        plint x0 = std::max(bulk.x0, (plint)std::floor(vertex[0]) - reach), x1 = std::min(bulk.x1, (plint)std::ceil(vertex[0]) + reach);
+        plint y0 = std::max(bulk.y0, (plint)std::floor(vertex[1]) - reach), y1 = std::min(bulk.y1, (plint)std::ceil(vertex[1]) + reach);
+        plint z0 = std::max(bulk.z0, (plint)std::floor(vertex[2]) - reach), z1 = std::min(bulk.z1, (plint)std::ceil(vertex[2]) + reach);
+        plint nearest[3] = {util::roundToInt(vertex[0]), util::roundToInt(vertex[1]), util::roundToInt(vertex[2])};
+        for (plint x = x0; x <= x1; x++) {
+          for (plint y = y0; y <= y1; y++) {
+            for (plint z = z0; z <= z1; z++) {
+              Array<T, 3> node(x, y, z);
+              bool isNearest = x == nearest[0] && y == nearest[1] && z == nearest[2];
+              if ((isNearest || norm(node - vertex) < distance) &&
+                  fluid.get(x - location.x, y - location.y, z - location.z).getDynamics().isBoundary()) {
+                return true;
+              }
+            }
+          }
+        }
+        return false;
+      };
+
+      for (std::size_t i = 0; i < positions.size(); i++) {
+        if (!inRegion(positions, i)) { continue; }
+        placeCell(positions, i, shapes[type], vertices);
+        if (std::any_of(vertices.begin(), vertices.end(), tooClose)) {
+          rejected.push_back(positions.id[i]);
+        }
+      }
+    }
+    std::set<std::uint32_t> skip = gatherRejected(rejected);
+    skipped += skip.size();
+
+    for (plint blockId : localBlocks) {
+      auto found = cells.blocks.find(blockId);
+      if (found == cells.blocks.end()) { continue; }
+      CellPositions const & positions = found->second;
+
+      HemoCellParticleField & particles = hemocell.cellfields->immersedParticles->getComponent(blockId);
+      Dot3D particleLocation = particles.getLocation();
+      Box3D domain = particles.getBoundingBox().shift(particleLocation.x, particleLocation.y, particleLocation.z);
+      auto inDomain = [&domain](Array<T, 3> const & p) {
+        return p[0] >= domain.x0 && p[0] <= domain.x1 && p[1] >= domain.y0 && p[1] <= domain.y1 &&
+               p[2] >= domain.z0 && p[2] <= domain.z1;
+      };
+
+      for (std::size_t i = 0; i < positions.size(); i++) {
+        if (!inRegion(positions, i) || skip.count(positions.id[i])) { continue; }
+        placeCell(positions, i, shapes[type], vertices);
+
+        const plint cellId = offset + positions.id[i];
+        for (std::size_t k = 0; k < vertices.size(); k++) {
+          if (!inDomain(vertices[k])) { continue; }
+          HemoCellParticle particle(vertices[k], cellId, k, ctype);
+          particles.addParticle(&particle);
+        }
+        created++;
+      }
+    }
+    offset += cells.total;
+  }
+
+  // vertices outside the bulk of their block were only added to the blocks
+  // that cover them, complete the envelopes and drop what is left over
+  hemocell.cellfields->syncEnvelopes();
+  hemocell.cellfields->deleteIncompleteCells();
+
+  double seconds = MPI_Wtime() - start;
+  hemo::global.statistics.addMetric("Particle Load Cells", (double)created);
+  hemo::global.statistics.addMetric("Particle Load Time", seconds);
+  hlog << "(ParticleLoader) created " << created << " local cell copies, skipped " << skipped
+       << " cells near solids, in " << seconds << " s" << std::endl;
+}
+
+}
+
+void loadParticlesScattered(HemoCell & hemocell, std::vector<std::string> const & cellTypes, Box3D const * region) {
+  hlog << "(ParticleLoader) Loading particle positions, one reader per node" << std::endl;
+  MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+  createCells(hemocell, cellTypes, region, [&](std::size_t type, double margin) {
+    return scatterCellPositions(management, cellTypes[type] + ".pos", param::dx, margin);
+  });
+}
+
+void loadParticlesScattered(HemoCell & hemocell, std::vector<std::string> const & cellTypes,
+                            std::vector<CellPositions> const & positions, Box3D const * region) {
+  if (positions.size() != cellTypes.size()) {
+    hlog << "(ParticleLoader) (Error) " << positions.size() << " position sets for " << cellTypes.size()
+         << " cell types" << std::endl;
+    exit(1);
+  }
+  hlog << "(ParticleLoader) Loading given particle positions" << std::endl;
+  MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+  createCells(hemocell, cellTypes, region, [&](std::size_t type, double margin) {
+    return selectCellPositions(management, positions[type], param::dx, margin);
+  });
+}
+
+}
+}
@@ -0,0 +1,90 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_PARTICLELOADER_H
+#define HEMOCELL_BENCH_PARTICLELOADER_H
+
+#include "hemocell.h"
+#include "../misc/cellPositions.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace hemo {
+namespace bench {
+
+/* Result of scatterCellPositions() */
+struct ScatteredCells {
+  /* Number of cells in the position file */
+  std::size_t total = 0;
+  /* The cells per local block id */
+  std::map<plb::plint, CellPositions> blocks;
+};
+
+/**
+ * The cells of positionFile (micrometer) whose centre lies within margin
+ * lattice points of the bulk of a block of this process.
+ *
+ * One process per node (MPI_COMM_TYPE_SHARED) reads the file and sends every
+ * process of its node only the cells of its own blocks with MPI_Scatterv.
+ * The .posb version of the file is used when it exists, the node reader then
+ * only reads the parts of the file that overlap the blocks of its node.
+ * Collective over the palabos communicator.
+ */
+ScatteredCells scatterCellPositions(plb::MultiBlockManagement3D const & management,
+                                    std::string const & positionFile, double dx, double margin);
+
+/**
+ * The same selection as scatterCellPositions() for cells that every process
+ * already has in memory, for example generated ones, nothing is communicated.
+ */
+ScatteredCells selectCellPositions(plb::MultiBlockManagement3D const & management,
+                                   CellPositions const & cells, double dx, double margin);
+
+/**
+ * Replacement for hemocell.loadParticles(): the positions of every cell type
+ * are scattered with scatterCellPositions() and every process only creates
+ * the vertices of the cells in its own blocks, so the work per process
+ * scales with its local number of cells instead of the global one.
+ *
+ * Cells are created from the mesh of their cell type, rotated by the angles
+ * (degrees) in the position file as HemoCell's meshRotation() does. Cell ids
+ * are the index in the position file, offset by the number of cells of the
+ * preceding cell types, so they are the same for every decomposition. Cells
+ * with a vertex on a solid node or closer to one than the distance of
+ * hemocell.setInitialMinimumDistanceFromSolid() are skipped, and so are cells
+ * whose centre is outside region (lattice units) when it is given. Whether a
+ * cell is skipped is decided once for all processes.
+ */
+void loadParticlesScattered(HemoCell & hemocell, std::vector<std::string> const & cellTypes,
+                            plb::Box3D const * region = nullptr);
+
+/* loadParticlesScattered() with the positions of every cell type (in the
+ * order of cellTypes) given instead of read from <cell type>.pos */
+void loadParticlesScattered(HemoCell & hemocell, std::vector<std::string> const & cellTypes,
+                            std::vector<CellPositions> const & positions, plb::Box3D const * region = nullptr);
+
+}
+}
+#endif
@@ -0,0 +1,153 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "rebalanceCost.h"
+
+#include <algorithm>
+
+#include <mpi.h>
+
+using namespace plb;
+
+namespace hemo {
+namespace bench {
+
+RebalanceCost::RebalanceCost(HemoCell & hemocell_, unsigned int penaltyIterations_, std::vector<std::string> partitionTimers_) :
+hemocell(hemocell_), penaltyIterations(std::max(1u, penaltyIterations_)), partitionTimers(partitionTimers_), before(penaltyIterations)
+{
+  MPI_Comm_rank(plb::global::mpi().getGlobalCommunicator(), &rank);
+}
+
+void RebalanceCost::addIteration(double seconds) {
+  if (!rebalanced) {
+    before[nBefore++ % before.size()] = seconds;
+  } else if (after.size() < penaltyIterations) {
+    after.push_back(seconds);
+  }
+}
+
+double RebalanceCost::partitionSeconds() {
+  double total = 0.;
+  for (std::string const & timer : partitionTimers) {
+    total += hemo::global.statistics.totalSeconds(timer);
+  }
+  return total;
+}
+
+std::map<RebalanceCost::BoxKey, RebalanceCost::BlockOwner> RebalanceCost::owners() {
+  MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+  std::map<plint, Box3D> const & bulks = management.getSparseBlockStructure().getBulks();
+  ThreadAttribution const & attribution = management.getThreadAttribution();
+
+  // particles are only known to the owner, every process knows all bulks
+  std::map<plint, std::size_t> index;
+  for (auto const & bulk : bulks) {
+    std::size_t i = index.size();
+    index[bulk.first] = i;
+  }
+  std::vector<double> particles(bulks.size(), 0.);
+  for (plint id : management.getLocalInfo().getBlocks()) {
+    particles[index[id]] = hemocell.cellfields->immersedParticles->getComponent(id).particles.size();
+  }
+  MPI_Allreduce(MPI_IN_PLACE, particles.data(), particles.size(), MPI_DOUBLE, MPI_SUM,
+                plb::global::mpi().getGlobalCommunicator());
+
+  std::map<BoxKey, BlockOwner> result;
+  for (auto const & bulk : bulks) {
+    Box3D const & box = bulk.second;
+    BlockOwner & owner = result[BoxKey{box.x0, box.x1, box.y0, box.y1, box.z0, box.z1}];
+    owner.rank = attribution.getMpiProcess(bulk.first);
+    owner.latticeBytes = (double)box.nCells() * sizeof(Cell<T,DESCRIPTOR>);
+    owner.particleBytes = particles[index[bulk.first]] * sizeof(HemoCellParticle);
+  }
+  return result;
+}
+
+void RebalanceCost::rebalance() {
+  std::map<BoxKey, BlockOwner> previous = owners();
+
+  // under the root, whatever timer happens to be current
+  Profiler & timer = hemo::global.statistics["rebalance"];
+  double partitionStart = partitionSeconds();
+  MPI_Barrier(plb::global::mpi().getGlobalCommunicator());
+  double start = MPI_Wtime();
+  timer.start();
+  hemocell.loadBalancer->doLoadBalance();
+  timer.stop();
+  seconds = MPI_Wtime() - start;
+  partitionTime = partitionSeconds() - partitionStart;
+  rebuildTime = seconds - partitionTime;
+  if (partitionTime == 0.) {
+    hlog << "(RebalanceCost) (Warning) none of the partition timers ran inside doLoadBalance(), "
+         << "the rebuild time is the whole rebalance" << std::endl;
+  }
+
+  sentLatticeBytes = sentParticleBytes = receivedLatticeBytes = receivedParticleBytes = 0.;
+  movedBlocks = unmatchedBlocks = 0.;
+  for (auto const & block : owners()) {
+    auto old = previous.find(block.first);
+    if (old == previous.end()) {
+      unmatchedBlocks++;
+      continue;
+    }
+    if (old->second.rank == block.second.rank) { continue; }
+
+    movedBlocks++;
+    if (old->second.rank == rank) {
+      sentLatticeBytes += old->second.latticeBytes;
+      sentParticleBytes += old->second.particleBytes;
+    }
+    if (block.second.rank == rank) {
+      receivedLatticeBytes += old->second.latticeBytes;
+      receivedParticleBytes += old->second.particleBytes;
+    }
+  }
+
+  rebalanced = true;
+  after.clear();
+}
+
+void RebalanceCost::addMetrics() {
+  std::size_t n = std::min(nBefore, before.size());
+  double mean = 0.;
+  for (std::size_t i = 0; i < n; i++) { mean += before[i] / n; }
+  double penalty = 0.;
+  for (double iteration : after) { penalty += iteration - mean; }
+
+  hemo::global.statistics.addMetric("Rebalance Time", seconds);
+  hemo::global.statistics.addMetric("Rebalance Partition Time", partitionTime);
+  hemo::global.statistics.addMetric("Rebalance Rebuild Time", rebuildTime);
+  hemo::global.statistics.addMetric("Rebalance Moved Blocks", movedBlocks);
+  hemo::global.statistics.addMetric("Rebalance Unmatched Blocks", unmatchedBlocks);
+  hemo::global.statistics.addMetric("Rebalance Sent Lattice Bytes", sentLatticeBytes);
+  hemo::global.statistics.addMetric("Rebalance Sent Particle Bytes", sentParticleBytes);
+  hemo::global.statistics.addMetric("Rebalance Received Lattice Bytes", receivedLatticeBytes);
+  hemo::global.statistics.addMetric("Rebalance Received Particle Bytes", receivedParticleBytes);
+  hemo::global.statistics.addMetric("Rebalance Iteration Time Before", mean);
+  hemo::global.statistics.addMetric("Rebalance First Iteration Time", after.empty() ? 0. : after.front());
+  hemo::global.statistics.addMetric("Rebalance Penalty", penalty);
+  hemo::global.statistics.addMetric("Rebalance Penalty Iterations", (double)after.size());
+}
+
+}
+}
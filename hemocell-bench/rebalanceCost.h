@@ -0,0 +1,98 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_REBALANCECOST_H
+#define HEMOCELL_BENCH_REBALANCECOST_H
+
+#include "hemocell.h"
+
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace hemo {
+namespace bench {
+
+/**
+ * Breakdown of a single doLoadBalance() into the parts that can be
+ * optimised separately:
+ *  - the time of the call itself, as the "rebalance" timer directly under
+ *    the root profiler. The timers HemoCell starts inside it become its
+ *    children in the profiler output
+ *  - of that time, the computation of the new partition (the growth of the
+ *    partitionTimers during the call) and the rest, the rebuild of the
+ *    lattice and particle fields
+ *  - the data that moved: per process the bytes of lattice cells and
+ *    particles of the blocks it gave away and received, blocks are matched
+ *    on their bulk so this works when the rebalance renumbers them
+ *  - the penalty afterwards: the extra time of the first penaltyIterations
+ *    iterations compared to the mean of the same number of iterations
+ *    before the rebalance, the first iteration is reported on its own
+ *
+ * Usage: call addIteration() with the time of every iteration, and
+ * rebalance() instead of doLoadBalance(). addMetrics() reports the last
+ * rebalance as "Rebalance ..." metrics.
+ */
+class RebalanceCost {
+public:
+  RebalanceCost(HemoCell & hemocell, unsigned int penaltyIterations, std::vector<std::string> partitionTimers);
+
+  void addIteration(double seconds);
+  /* Collective: hemocell.loadBalancer->doLoadBalance() with the measurements around it */
+  void rebalance();
+  /* Add the metrics of the last rebalance to hemo::global.statistics */
+  void addMetrics();
+
+private:
+  typedef std::array<plb::plint, 6> BoxKey;
+  struct BlockOwner {
+    int rank;
+    double latticeBytes;
+    double particleBytes;
+  };
+  /* Collective: owner and data size of every block, keyed by its bulk */
+  std::map<BoxKey, BlockOwner> owners();
+
+  /* Seconds this process spent in the partitionTimers so far */
+  double partitionSeconds();
+
+  HemoCell & hemocell;
+  unsigned int penaltyIterations;
+  std::vector<std::string> partitionTimers;
+  int rank;
+
+  /* the last penaltyIterations iteration times before the rebalance (a ring) and after it */
+  std::vector<double> before, after;
+  std::size_t nBefore = 0;
+  bool rebalanced = false;
+
+  double seconds = 0., partitionTime = 0., rebuildTime = 0.;
+  double sentLatticeBytes = 0., sentParticleBytes = 0.;
+  double receivedLatticeBytes = 0., receivedParticleBytes = 0.;
+  double movedBlocks = 0., unmatchedBlocks = 0.;
+};
+
+}
+}
+#endif
@@ -0,0 +1,101 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "rebalancePolicy.h"
+
+#include <algorithm>
+
+#include "parallelism/mpiManager.h"
+#include <mpi.h>
+
+namespace hemo {
+namespace bench {
+
+AdaptiveRebalance::AdaptiveRebalance(unsigned int checkEvery_, unsigned long horizon_, double initialCost_,
+                                     unsigned int penaltyIterations_) :
+checkEvery(std::max(1u, checkEvery_)), horizon(horizon_), initialCost(initialCost_), penaltyIterations(penaltyIterations_)
+{ }
+
+void AdaptiveRebalance::addIteration(double seconds) {
+  // the first iterations after a rebalance are part of its cost
+  if (penaltyLeft > 0) {
+    penaltyLeft--;
+    pendingCost += std::max(0., seconds - balancedIteration);
+    return;
+  }
+  windowSeconds += seconds;
+  windowIterations++;
+}
+
+void AdaptiveRebalance::addRebalance(double seconds) {
+  nRebalances++;
+  balancedIteration = decision.meanIteration;
+  penaltyLeft = penaltyIterations;
+  penaltyPending = penaltyIterations > 0;
+  pendingCost = 0.;
+  costSum += seconds;
+  nCosts++;
+  windowSeconds = 0.;
+  windowIterations = 0;
+}
+
+double AdaptiveRebalance::cost() const {
+  return nCosts > 0 ? costSum / nCosts : initialCost;
+}
+
+bool AdaptiveRebalance::check(unsigned long iteration, unsigned long remaining) {
+  if (iteration == 0 || iteration % checkEvery != 0) { return false; }
+
+  // [time per iteration, penalty of the last rebalance], both as maximum over the processes
+  double local = windowIterations > 0 ? windowSeconds / windowIterations : 0.;
+  double maxima[2] = {local, pendingCost};
+  double mean = 0.;
+  int nProcs;
+  MPI_Comm_size(plb::global::mpi().getGlobalCommunicator(), &nProcs);
+  MPI_Allreduce(MPI_IN_PLACE, maxima, 2, MPI_DOUBLE, MPI_MAX, plb::global::mpi().getGlobalCommunicator());
+  MPI_Allreduce(&local, &mean, 1, MPI_DOUBLE, MPI_SUM, plb::global::mpi().getGlobalCommunicator());
+  mean /= nProcs;
+
+  // the penalty is complete once its iterations are over, the same on every process
+  if (penaltyPending && penaltyLeft == 0) {
+    costSum += maxima[1];
+    penaltyPending = false;
+    pendingCost = 0.;
+  }
+
+  nChecks++;
+  decision.iteration = iteration;
+  decision.maxIteration = maxima[0];
+  decision.meanIteration = mean;
+  decision.horizon = std::min(horizon, remaining);
+  decision.predictedGain = (maxima[0] - mean) * decision.horizon;
+  decision.estimatedCost = cost();
+  decision.rebalance = windowIterations > 0 && decision.predictedGain > decision.estimatedCost;
+
+  windowSeconds = 0.;
+  windowIterations = 0;
+  return decision.rebalance;
+}
+
+}
+}
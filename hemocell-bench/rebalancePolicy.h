@@ -0,0 +1,96 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_REBALANCEPOLICY_H
+#define HEMOCELL_BENCH_REBALANCEPOLICY_H
+
+namespace hemo {
+namespace bench {
+
+/* The measurements behind one AdaptiveRebalance decision */
+struct RebalanceDecision {
+  unsigned long iteration;
+  /* slowest and mean process, compute seconds per iteration over the window */
+  double maxIteration, meanIteration;
+  /* iterations the gain is predicted over */
+  unsigned long horizon;
+  double predictedGain;
+  double estimatedCost;
+  bool rebalance;
+};
+
+/**
+ * Rebalance only when it pays off. Every process measures the compute time
+ * of its iterations, every checkEvery iterations the window is reduced over
+ * all processes. The compute time leaves out the waiting in the
+ * communication, which hides the imbalance: the fast processes wait for the
+ * slow ones, so all iterations take about as long. The time lost to
+ * imbalance is the difference between the slowest and the mean process, a
+ * rebalance is predicted to win that back for the remaining iterations, up
+ * to horizon. It is triggered when this gain exceeds the cost of a
+ * rebalance.
+ *
+ * The cost starts at initialCost (for example the doLoadBalance() time of
+ * the rebalancing-cost benchmark) and is replaced by the mean measured cost
+ * of the rebalances of this run, which includes the slower iterations right
+ * after a rebalance.
+ */
+class AdaptiveRebalance {
+public:
+  AdaptiveRebalance(unsigned int checkEvery, unsigned long horizon, double initialCost, unsigned int penaltyIterations);
+
+  /* Compute time of one iteration of this process */
+  void addIteration(double seconds);
+  /* Collective every checkEvery iterations, false in between */
+  bool check(unsigned long iteration, unsigned long remaining);
+  /* Maximum time over all processes of a rebalance that was just done */
+  void addRebalance(double seconds);
+
+  /* The last decision of check() */
+  RebalanceDecision const & lastDecision() const { return decision; }
+  unsigned int checks() const { return nChecks; }
+  unsigned int rebalances() const { return nRebalances; }
+  double cost() const;
+
+private:
+  unsigned int checkEvery;
+  unsigned long horizon;
+  double initialCost;
+  unsigned int penaltyIterations;
+
+  double windowSeconds = 0.;
+  unsigned int windowIterations = 0;
+  /* iteration time before the last rebalance, for the penalty afterwards */
+  double balancedIteration = 0.;
+  unsigned int penaltyLeft = 0;
+  bool penaltyPending = false;
+  double pendingCost = 0.;
+
+  double costSum = 0.;
+  unsigned int nChecks = 0, nRebalances = 0, nCosts = 0;
+  RebalanceDecision decision = {};
+};
+
+}
+}
+#endif
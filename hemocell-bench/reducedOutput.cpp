@@ -0,0 +1,268 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "reducedOutput.h"
+#include "particleHelpers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include <mpi.h>
+#include <sys/stat.h>
+
+using namespace plb;
+
+namespace hemo {
+namespace bench {
+
+namespace {
+
+/* Open a csv file for appending, the header is written if it is new */
+void openSeries(std::ofstream & file, std::string const & filename, std::string const & header) {
+  bool exists = std::ifstream(filename).good();
+  file.open(filename, std::ios::app);
+  if (!exists) {
+    file << header << "\n";
+  }
+}
+
+}
+
+ReducedOutput::ReducedOutput(HemoCell & hemocell_, std::vector<std::string> const & cellTypes_,
+                             std::string const & directory, int profileBins_, int forceBins_,
+                             int cellBins_, int cellBinWidth_, bool rawCellsPerBlock_) :
+hemocell(hemocell_), cellTypes(cellTypes_), profileBins(profileBins_), forceBins(forceBins_),
+cellBins(cellBins_), cellBinWidth(cellBinWidth_), rawCellsPerBlock(rawCellsPerBlock_)
+{
+  MPI_Comm_rank(plb::global::mpi().getGlobalCommunicator(), &rank);
+  if (rank == 0) {
+    mkdir(directory.c_str(), 0755);
+    openSeries(profileFile, directory + "/velocityProfile.csv", "iteration,bin,z,ux,uy,uz,nodes");
+    openSeries(histogramFile, directory + "/cellsHistogram.csv", "iteration,type,bin,cells,blocks");
+    if (rawCellsPerBlock) {
+      openSeries(cellsFile, directory + "/cellsPerBlock.csv", "iteration,block,type,cells");
+    }
+    openSeries(forceFile, directory + "/forcePercentiles.csv", "iteration,type,mean,p5,p25,p50,p75,p95,p99,max");
+  }
+}
+
+void ReducedOutput::write() {
+  velocityProfile();
+  cellsHistogram();
+  if (rawCellsPerBlock) {
+    cellsPerBlock();
+  }
+  forcePercentiles();
+}
+
+void ReducedOutput::velocityProfile() {
+  MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+  Box3D domain = hemocell.lattice->getBoundingBox();
+  const double binHeight = double(domain.getNz()) / profileBins;
+
+  // ux, uy, uz and the number of fluid nodes per bin
+  std::vector<double> sums(4 * profileBins, 0.);
+  for (plint id : management.getLocalInfo().getBlocks()) {
+    BlockLattice3D<T,DESCRIPTOR> & lattice = hemocell.lattice->getComponent(id);
+    Dot3D location = lattice.getLocation();
+    Box3D bulk = management.getSparseBlockStructure().getBulks().at(id);
+
+    for (plint x = bulk.x0; x <= bulk.x1; x++) {
+      for (plint y = bulk.y0; y <= bulk.y1; y++) {
+        for (plint z = bulk.z0; z <= bulk.z1; z++) {
+          Cell<T,DESCRIPTOR> & cell = lattice.get(x - location.x, y - location.y, z - location.z);
+          if (cell.getDynamics().isBoundary()) { continue; }
+          int bin = std::min(profileBins - 1, int((z - domain.z0) / binHeight));
+          Array<T,3> u;
+          cell.computeVelocity(u);
+          sums[4 * bin] += u[0];
+          sums[4 * bin + 1] += u[1];
+          sums[4 * bin + 2] += u[2];
+          sums[4 * bin + 3] += 1.;
+        }
+      }
+    }
+  }
+
+  MPI_Reduce(rank == 0 ? MPI_IN_PLACE : sums.data(), sums.data(), sums.size(), MPI_DOUBLE, MPI_SUM, 0,
+             plb::global::mpi().getGlobalCommunicator());
+  if (rank != 0) { return; }
+
+  const T toMpS = param::dx / param::dt;
+  for (int bin = 0; bin < profileBins; bin++) {
+    double nodes = sums[4 * bin + 3];
+    double scale = nodes > 0. ? toMpS / nodes : 0.;
+    profileFile << hemocell.iter << "," << bin << "," << (domain.z0 + (bin + 0.5) * binHeight) * param::dx << ","
+                << sums[4 * bin] * scale << "," << sums[4 * bin + 1] * scale << "," << sums[4 * bin + 2] * scale << ","
+                << nodes << "\n";
+  }
+  profileFile.flush();
+}
+
+void ReducedOutput::cellsHistogram() {
+  MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+  std::map<plint, Box3D> const & bulks = management.getSparseBlockStructure().getBulks();
+  std::map<pluint, std::size_t> typeIndex = cellTypeIndex(hemocell, cellTypes);
+  const std::size_t nTypes = cellTypes.size();
+
+  // the blocks are local, so their counts are complete without communication,
+  // only the fixed size histograms are summed
+  std::vector<double> histogram(nTypes * cellBins, 0.);
+  std::vector<std::size_t> counts(nTypes);
+  for (plint id : management.getLocalInfo().getBlocks()) {
+    Box3D const & bulk = bulks.at(id);
+    std::fill(counts.begin(), counts.end(), 0);
+    for (HemoCellParticle const & particle : hemocell.cellfields->immersedParticles->getComponent(id).particles) {
+      if (particle.sv.vertexId != 0 || !inBulk(bulk, particle.sv.position)) { continue; }
+      auto type = typeIndex.find(particle.sv.celltype);
+      if (type != typeIndex.end()) {
+        counts[type->second]++;
+      }
+    }
+    for (std::size_t t = 0; t < nTypes; t++) {
+      int bin = std::min<std::size_t>(cellBins - 1, counts[t] / cellBinWidth);
+      histogram[t * cellBins + bin] += 1.;
+    }
+  }
+
+  MPI_Reduce(rank == 0 ? MPI_IN_PLACE : histogram.data(), histogram.data(), histogram.size(), MPI_DOUBLE, MPI_SUM, 0,
+             plb::global::mpi().getGlobalCommunicator());
+  if (rank != 0) { return; }
+
+  for (std::size_t t = 0; t < nTypes; t++) {
+    for (int bin = 0; bin < cellBins; bin++) {
+      histogramFile << hemocell.iter << "," << cellTypes[t] << "," << bin << "," << bin * cellBinWidth << ","
+                    << histogram[t * cellBins + bin] << "\n";
+    }
+  }
+  histogramFile.flush();
+}
+
+void ReducedOutput::cellsPerBlock() {
+  MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+  std::map<plint, Box3D> const & bulks = management.getSparseBlockStructure().getBulks();
+
+  // every process knows all block ids, so the counts can be summed in place
+  std::map<plint, std::size_t> blockIndex;
+  std::vector<plint> ids;
+  for (auto const & bulk : bulks) {
+    blockIndex[bulk.first] = ids.size();
+    ids.push_back(bulk.first);
+  }
+  std::map<pluint, std::size_t> typeIndex = cellTypeIndex(hemocell, cellTypes);
+
+  const std::size_t nTypes = cellTypes.size();
+  std::vector<double> counts(ids.size() * nTypes, 0.);
+  for (plint id : management.getLocalInfo().getBlocks()) {
+    Box3D const & bulk = bulks.at(id);
+    for (HemoCellParticle const & particle : hemocell.cellfields->immersedParticles->getComponent(id).particles) {
+      if (particle.sv.vertexId != 0 || !inBulk(bulk, particle.sv.position)) { continue; }
+      auto type = typeIndex.find(particle.sv.celltype);
+      if (type != typeIndex.end()) {
+        counts[blockIndex[id] * nTypes + type->second] += 1.;
+      }
+    }
+  }
+
+  MPI_Reduce(rank == 0 ? MPI_IN_PLACE : counts.data(), counts.data(), counts.size(), MPI_DOUBLE, MPI_SUM, 0,
+             plb::global::mpi().getGlobalCommunicator());
+  if (rank != 0) { return; }
+
+  for (std::size_t b = 0; b < ids.size(); b++) {
+    for (std::size_t t = 0; t < nTypes; t++) {
+      cellsFile << hemocell.iter << "," << ids[b] << "," << cellTypes[t] << "," << counts[b * nTypes + t] << "\n";
+    }
+  }
+  cellsFile.flush();
+}
+
+void ReducedOutput::forcePercentiles() {
+  MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+  std::map<plint, Box3D> const & bulks = management.getSparseBlockStructure().getBulks();
+  std::vector<plint> const & localBlocks = management.getLocalInfo().getBlocks();
+
+  std::map<pluint, std::size_t> typeIndex = cellTypeIndex(hemocell, cellTypes);
+  const std::size_t nTypes = cellTypes.size();
+
+  // vertex force magnitudes of the bulk particles, per type
+  std::vector<std::vector<double>> forces(nTypes);
+  for (plint id : localBlocks) {
+    Box3D const & bulk = bulks.at(id);
+    for (HemoCellParticle const & particle : hemocell.cellfields->immersedParticles->getComponent(id).particles) {
+      if (!inBulk(bulk, particle.sv.position)) { continue; }
+      auto type = typeIndex.find(particle.sv.celltype);
+      if (type != typeIndex.end()) {
+        forces[type->second].push_back(norm(particle.sv.force));
+      }
+    }
+  }
+
+  // first the maximum and sum, then a histogram between zero and the maximum
+  std::vector<double> maxima(nTypes, 0.), sums(2 * nTypes, 0.);
+  for (std::size_t t = 0; t < nTypes; t++) {
+    for (double f : forces[t]) {
+      maxima[t] = std::max(maxima[t], f);
+      sums[2 * t] += f;
+    }
+    sums[2 * t + 1] = forces[t].size();
+  }
+  MPI_Allreduce(MPI_IN_PLACE, maxima.data(), nTypes, MPI_DOUBLE, MPI_MAX, plb::global::mpi().getGlobalCommunicator());
+
+  std::vector<double> histogram(nTypes * forceBins, 0.);
+  for (std::size_t t = 0; t < nTypes; t++) {
+    double width = maxima[t] > 0. ? maxima[t] / forceBins : 1.;
+    for (double f : forces[t]) {
+      histogram[t * forceBins + std::min(forceBins - 1, int(f / width))] += 1.;
+    }
+  }
+  histogram.insert(histogram.end(), sums.begin(), sums.end());
+  MPI_Reduce(rank == 0 ? MPI_IN_PLACE : histogram.data(), histogram.data(), histogram.size(), MPI_DOUBLE, MPI_SUM, 0,
+             plb::global::mpi().getGlobalCommunicator());
+  if (rank != 0) { return; }
+
+  const double topN = param::df * 1.0e12;
+  const double percentiles[] = {0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+  for (std::size_t t = 0; t < nTypes; t++) {
+    double sum = histogram[nTypes * forceBins + 2 * t];
+    double count = histogram[nTypes * forceBins + 2 * t + 1];
+    double width = maxima[t] / forceBins;
+
+    forceFile << hemocell.iter << "," << cellTypes[t] << "," << (count > 0. ? sum / count * topN : 0.);
+    for (double p : percentiles) {
+      // upper edge of the bin in which the percentile falls
+      double seen = 0.;
+      int bin = 0;
+      while (bin < forceBins - 1 && seen + histogram[t * forceBins + bin] < p * count) {
+        seen += histogram[t * forceBins + bin];
+        bin++;
+      }
+      forceFile << "," << (count > 0. ? (bin + 1) * width * topN : 0.);
+    }
+    forceFile << "," << maxima[t] * topN << "\n";
+  }
+  forceFile.flush();
+}
+
+}
+}
@@ -0,0 +1,84 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_REDUCEDOUTPUT_H
+#define HEMOCELL_BENCH_REDUCEDOUTPUT_H
+
+#include "hemocell.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace hemo {
+namespace bench {
+
+/**
+ * In-situ reductions written instead of the full fields, a few kilobytes
+ * per output iteration. Rank 0 appends a line per value to three csv files
+ * in the output directory:
+ *  - velocityProfile.csv: mean fluid velocity (m/s) in profileBins slabs
+ *    along z (iteration,bin,z,ux,uy,uz,nodes)
+ *  - cellsHistogram.csv: number of blocks per number of cells of every
+ *    type whose first vertex lies in the bulk of the block, in cellBins bins
+ *    of cellBinWidth cells, the last bin also holds all fuller blocks
+ *    (iteration,type,bin,cells,blocks)
+ *  - forcePercentiles.csv: percentiles of the vertex force magnitude (pN)
+ *    per cell type (iteration,type,mean,p5,p25,p50,p75,p95,p99,max)
+ *
+ * With rawCellsPerBlock also cellsPerBlock.csv, the count of every block
+ * (iteration,block,type,cells), which grows with the number of blocks.
+ *
+ * The percentiles come from a global histogram of forceBins bins between
+ * zero and the maximum force, so they are exact up to max / forceBins.
+ * Every write() is collective.
+ */
+class ReducedOutput {
+public:
+  ReducedOutput(HemoCell & hemocell, std::vector<std::string> const & cellTypes,
+                std::string const & directory, int profileBins, int forceBins,
+                int cellBins, int cellBinWidth, bool rawCellsPerBlock);
+
+  void write();
+
+private:
+  void velocityProfile();
+  void cellsHistogram();
+  void cellsPerBlock();
+  void forcePercentiles();
+
+  HemoCell & hemocell;
+  std::vector<std::string> cellTypes;
+  int profileBins;
+  int forceBins;
+  int cellBins;
+  int cellBinWidth;
+  bool rawCellsPerBlock;
+  int rank;
+
+  std::ofstream profileFile, histogramFile, cellsFile, forceFile;
+};
+
+}
+}
+#endif
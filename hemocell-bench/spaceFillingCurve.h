@@ -0,0 +1,81 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_SPACEFILLINGCURVE_H
+#define HEMOCELL_BENCH_SPACEFILLINGCURVE_H
+
+#include <cstdint>
+
+namespace hemo {
+namespace bench {
+
+/* Position of (x, y, z) along the 3D Morton (z-order) curve, every coordinate
+ * has `bits` significant bits (at most 21) */
+inline std::uint64_t mortonKey(std::uint32_t x, std::uint32_t y, std::uint32_t z, int bits) {
+  std::uint64_t key = 0;
+  for (int b = bits - 1; b >= 0; b--) {
+    key = (key << 3) | (((x >> b) & 1) << 2) | (((y >> b) & 1) << 1) | ((z >> b) & 1);
+  }
+  return key;
+}
+
+/* Position of (x, y, z) along the 3D Hilbert curve, every coordinate has
+ * `bits` significant bits (at most 21). Consecutive keys are always face
+ * neighbours, unlike the Morton curve.
+ *
+ * J. Skilling, Programming the Hilbert curve, AIP Conf. Proc. 707 (2004)
+ */
+inline std::uint64_t hilbertKey(std::uint32_t x, std::uint32_t y, std::uint32_t z, int bits) {
+  std::uint32_t X[3] = {x, y, z};
+  const std::uint32_t M = 1u << (bits - 1);
+
+  // inverse undo excess work
+  for (std::uint32_t Q = M; Q > 1; Q >>= 1) {
+    const std::uint32_t P = Q - 1;
+    for (int i = 0; i < 3; i++) {
+      if (X[i] & Q) {
+        X[0] ^= P;
+      } else {
+        std::uint32_t t = (X[0] ^ X[i]) & P;
+        X[0] ^= t;
+        X[i] ^= t;
+      }
+    }
+  }
+
+  // gray encode
+  X[1] ^= X[0];
+  X[2] ^= X[1];
+  std::uint32_t t = 0;
+  for (std::uint32_t Q = M; Q > 1; Q >>= 1) {
+    if (X[2] & Q) { t ^= Q - 1; }
+  }
+  for (int i = 0; i < 3; i++) { X[i] ^= t; }
+
+  // the transposed key interleaved is the actual key
+  return mortonKey(X[0], X[1], X[2], bits);
+}
+
+}
+}
+#endif
@@ -0,0 +1,125 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "sparseDecomposition.h"
+
+#include <vector>
+
+#include <mpi.h>
+
+using namespace plb;
+
+namespace hemo {
+namespace bench {
+
+namespace {
+
+/* Number of cells of the flag matrix with the given flag in box, box lies within the bulk of the local component id */
+double countFlagged(MultiScalarField3D<int> & flagMatrix, plint id, Box3D const & box, int flag) {
+  ScalarField3D<int> & component = flagMatrix.getComponent(id);
+  Dot3D location = component.getLocation();
+  double count = 0.;
+  for (plint x = box.x0; x <= box.x1; x++) {
+    for (plint y = box.y0; y <= box.y1; y++) {
+      for (plint z = box.z0; z <= box.z1; z++) {
+        if (component.get(x - location.x, y - location.y, z - location.z) == flag) { count += 1.; }
+      }
+    }
+  }
+  return count;
+}
+
+}
+
+std::map<plint, double> flaggedCellsPerBlock(MultiScalarField3D<int> & flagMatrix, int flag, plint margin) {
+  MultiBlockManagement3D const & management = flagMatrix.getMultiBlockManagement();
+  std::map<plint, Box3D> const & bulks = management.getSparseBlockStructure().getBulks();
+
+  // every process counts in the bulks of its own blocks, the sum over all
+  // processes fills in the rest. With a margin the cells of a local bulk are
+  // also counted for every other block whose widened bulk covers them
+  std::map<plint, std::size_t> index;
+  for (auto const & bulk : bulks) {
+    std::size_t i = index.size();
+    index[bulk.first] = i;
+  }
+
+  std::vector<double> counts(bulks.size(), 0.);
+  for (plint id : management.getLocalInfo().getBlocks()) {
+    Box3D const & local = bulks.at(id);
+    if (margin == 0) {
+      counts[index[id]] = countFlagged(flagMatrix, id, local, flag);
+      continue;
+    }
+    for (auto const & bulk : bulks) {
+      Box3D covered;
+      if (intersect(bulk.second.enlarge(margin), local, covered)) {
+        counts[index[bulk.first]] += countFlagged(flagMatrix, id, covered, flag);
+      }
+    }
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, counts.data(), counts.size(), MPI_DOUBLE, MPI_SUM, plb::global::mpi().getGlobalCommunicator());
+
+  std::map<plint, double> result;
+  for (auto const & bulk : bulks) {
+    result[bulk.first] = counts[index[bulk.first]];
+  }
+  return result;
+}
+
+std::unique_ptr<MultiBlockManagement3D> createSparseManagement(MultiBlockManagement3D const & management,
+                                                               std::map<plint, double> const & weights,
+                                                               std::map<plint, double> const & reach,
+                                                               plint nProcs) {
+  SparseBlockStructure3D const & blocks = management.getSparseBlockStructure();
+  SparseBlockStructure3D kept(blocks.getBoundingBox());
+  std::map<plint, double> keptWeights;
+  for (auto const & bulk : blocks.getBulks()) {
+    auto near = reach.find(bulk.first);
+    if (near != reach.end() && near->second > 0.) {
+      kept.addBlock(bulk.second, bulk.first);
+      auto weight = weights.find(bulk.first);
+      keptWeights[bulk.first] = weight == weights.end() ? 0. : weight->second;
+    }
+  }
+
+  BlockAttribution attribution = attributeInOrder(hilbertOrder(kept), nProcs, keptWeights);
+  return std::unique_ptr<MultiBlockManagement3D>(
+      new MultiBlockManagement3D(kept, new ExplicitThreadAttribution(attribution),
+                                 management.getEnvelopeWidth(), management.getRefinementLevel()));
+}
+
+std::unique_ptr<MultiScalarField3D<int>> redistribute(MultiScalarField3D<int> & field,
+                                                      MultiBlockManagement3D const & management) {
+  std::unique_ptr<MultiScalarField3D<int>> result(
+      new MultiScalarField3D<int>(management,
+                                  defaultMultiBlockPolicy3D().getBlockCommunicator(),
+                                  defaultMultiBlockPolicy3D().getCombinedStatistics(),
+                                  defaultMultiBlockPolicy3D().getMultiScalarAccess<int>()));
+  copyNonLocal(field, *result, field.getBoundingBox());
+  return result;
+}
+
+}
+}
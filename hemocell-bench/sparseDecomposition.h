@@ -0,0 +1,66 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_SPARSEDECOMPOSITION_H
+#define HEMOCELL_BENCH_SPARSEDECOMPOSITION_H
+
+#include "blockAttribution.h"
+
+#include "palabos3D.h"
+
+#include <map>
+#include <memory>
+
+namespace hemo {
+namespace bench {
+
+/* Collective: number of cells of the flag matrix with the given flag in the
+ * bulk of every block widened by margin, known to all processes. Only the
+ * bulks are read, so the envelopes of the flag matrix need not be filled */
+std::map<plb::plint, double> flaggedCellsPerBlock(plb::MultiScalarField3D<int> & flagMatrix, int flag,
+                                                  plb::plint margin = 0);
+
+/**
+ * Geometry aware decomposition: the blocks of management without fluid
+ * within their envelope (reach, the fluid cells of flaggedCellsPerBlock()
+ * with the envelope width as margin) are dropped. An all solid block next to
+ * fluid is kept, its wall lies in the envelope of the fluid block and needs
+ * an owner. The rest is attributed along the Hilbert curve through the block
+ * centres, in contiguous ranges of equal weight.
+ *
+ * The returned management keeps the ids, bulks, envelope width and
+ * refinement level of the kept blocks.
+ */
+std::unique_ptr<plb::MultiBlockManagement3D> createSparseManagement(plb::MultiBlockManagement3D const & management,
+                                                                    std::map<plb::plint, double> const & weights,
+                                                                    std::map<plb::plint, double> const & reach,
+                                                                    plb::plint nProcs);
+
+/* Collective: copy of field on another management, blocks of the new
+ * management that are not in the old one are left at zero */
+std::unique_ptr<plb::MultiScalarField3D<int>> redistribute(plb::MultiScalarField3D<int> & field,
+                                                           plb::MultiBlockManagement3D const & management);
+
+}
+}
+#endif
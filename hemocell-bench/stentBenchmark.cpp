@@ -0,0 +1,241 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "stentBenchmark.h"
+#include "geometryCache.h"
+#include "sparseDecomposition.h"
+
+#include <helper/voxelizeDomain.h>
+#include "rbcHighOrderModel.h"
+#include "pltSimpleModel.h"
+#include "helper/hemocellInit.hh"
+#include "writeCellInfoCSV.h"
+
+#include "palabos3D.h"
+#include "palabos3D.hh"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <vector>
+
+namespace hemo {
+namespace bench {
+
+StentBenchmark::StentBenchmark(int argc, char * argv[]) : BenchmarkDriver(argc, argv)
+{
+  tcheckpoint = (*cfg)["sim"]["tcheckpoint"].read<unsigned int>();
+  tcsv = (*cfg)["sim"]["tcsv"].read<unsigned int>();
+  forceStatistics = true;
+}
+
+std::string StentBenchmark::geometryKey() {
+  std::stringstream parameters;
+  parameters << "fluidEnvelope=" << (*cfg)["domain"]["fluidEnvelope"].read<int>()
+             << " refDirN=" << (*cfg)["domain"]["refDirN"].read<int>()
+             << " refDir=" << (*cfg)["domain"]["refDir"].read<int>()
+             << " blockSize=" << (*cfg)["domain"]["blockSize"].read<int>()
+             << " particleEnvelope=" << (*cfg)["domain"]["particleEnvelope"].read<int>()
+             << " processes=" << plb::global::mpi().getSize();
+
+  std::uint64_t hash = hashString(parameters.str(), hashFile((*cfg)["domain"]["geometry"].read<string>()));
+  std::stringstream key;
+  key << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return key.str();
+}
+
+void StentBenchmark::voxelize() {
+  double start = MPI_Wtime();
+  std::string cacheDirectory = benchmarkOption<std::string>("geometryCache", "geometry-cache");
+  std::unique_ptr<GeometryCache> cache;
+
+  if (cacheDirectory != "off") {
+    cache.reset(new GeometryCache(cacheDirectory, geometryKey()));
+    if (cache->exists()) {
+      hlog << "(stent_strut) (Geometry) loading cached geometry from " << cacheDirectory << endl;
+      std::unique_ptr<MultiScalarField3D<int>> cached;
+      cache->load(geometryManagement, cached);
+      flagMatrix.reset(cached.release());
+      hemo::global.statistics.addMetric("Geometry Setup Time", MPI_Wtime() - start);
+      hemo::global.statistics.addMetric("geometry", std::string("cached"));
+      return;
+    }
+  }
+
+  hlogfile << "(stent_strut) (Geometry) reading and voxelizing STL file " << (*cfg)["domain"]["geometry"].read<string>() << endl;
+
+  getFlagMatrixFromSTL((*cfg)["domain"]["geometry"].read<string>(),
+                       (*cfg)["domain"]["fluidEnvelope"].read<int>(),
+                       (*cfg)["domain"]["refDirN"].read<int>(),
+                       (*cfg)["domain"]["refDir"].read<int>(),
+                       voxelizedDomain, flagMatrix,
+                       (*cfg)["domain"]["blockSize"].read<int>(),
+                       (*cfg)["domain"]["particleEnvelope"].read<int>());
+  geometryManagement.reset(new MultiBlockManagement3D(voxelizedDomain->getMultiBlockManagement()));
+
+  if (cache) {
+    hlog << "(stent_strut) (Geometry) storing voxelized geometry in " << cacheDirectory << endl;
+    // the flag matrix is a copy of the voxel matrix, it has the same blocks
+    cache->store(*geometryManagement, *flagMatrix);
+  }
+  hemo::global.statistics.addMetric("Geometry Setup Time", MPI_Wtime() - start);
+  hemo::global.statistics.addMetric("geometry", std::string("voxelized"));
+}
+
+void StentBenchmark::decompose() {
+  std::string decomposition = benchmarkOption<std::string>("decomposition", "voxelized");
+  hemo::global.statistics.addMetric("decomposition", decomposition);
+  if (decomposition == "voxelized") { return; }
+  if (decomposition != "sparse") {
+    hlog << "(stent_strut) (Error) unknown decomposition \"" << decomposition << "\", available: voxelized sparse" << endl;
+    exit(1);
+  }
+
+  // the work of a block in fluid cell updates, a cell counts as the given
+  // number of fluid cells
+  std::map<plint, double> weights = flaggedCellsPerBlock(*flagMatrix, 1);
+  // blocks without fluid are only dropped when no fluid block reaches them with its envelope
+  std::map<plint, double> reach = flaggedCellsPerBlock(*flagMatrix, 1, geometryManagement->getEnvelopeWidth());
+  SparseBlockStructure3D const & blocks = geometryManagement->getSparseBlockStructure();
+  const double rbcWeight = benchmarkOption<double>("rbcWeight", 500.);
+  const double pltWeight = benchmarkOption<double>("pltWeight", 50.);
+  std::map<plint, double> rbcs = expectedCellsPerBlock(blocks, "RBC.pos", param::dx);
+  std::map<plint, double> plts = expectedCellsPerBlock(blocks, "PLT.pos", param::dx);
+
+  plint dropped = 0;
+  for (auto & weight : weights) {
+    if (reach[weight.first] == 0.) {
+      dropped++;
+      continue;
+    }
+    weight.second += rbcWeight * rbcs[weight.first] + pltWeight * plts[weight.first];
+  }
+
+  plint nProcs = plb::global::mpi().getSize();
+  std::unique_ptr<MultiBlockManagement3D> sparse = createSparseManagement(*geometryManagement, weights, reach, nProcs);
+
+  std::vector<double> load(nProcs, 0.);
+  for (auto const & weight : weights) {
+    if (reach[weight.first] > 0.) {
+      load[sparse->getThreadAttribution().getMpiProcess(weight.first)] += weight.second;
+    }
+  }
+  double mean = 0., max = 0.;
+  for (double l : load) {
+    mean += l / nProcs;
+    max = std::max(max, l);
+  }
+  hlog << "(stent_strut) (Decomposition) dropped " << dropped << " of " << weights.size()
+       << " blocks without fluid within the envelope, predicted imbalance " << (mean > 0. ? (max / mean - 1.) * 100. : 0.) << "%" << endl;
+  hemo::global.statistics.addMetric("Dropped Blocks", (double)dropped);
+  hemo::global.statistics.addMetric("Predicted Load", load[plb::global::mpi().getRank()]);
+
+  std::unique_ptr<MultiScalarField3D<int>> flags = redistribute(*flagMatrix, *sparse);
+  flagMatrix.reset(flags.release());
+  geometryManagement = std::move(sparse);
+}
+
+void StentBenchmark::buildLattice() {
+  // ----------------- Read in config file & geometry ---------------------------
+  voxelize();
+
+  plint nx = (*cfg)["domain"]["refDirN"].read<int>();
+  plint ny = 0.5*nx;
+  plint nz = 0.75*nx;
+  param::lbm_shear_parameters((*cfg),nz);
+  param::printParameters();
+
+  // needs param::dx for the expected cell positions
+  decompose();
+
+  // ------------------------ Init lattice --------------------------------
+  pcout << "(stent_strut) Initializing lattice: " << nx <<"x" << ny <<"x" << nz << " [lu]" << std::endl;
+
+  hemocell.lattice = new MultiBlockLattice3D<T,DESCRIPTOR>(
+            *geometryManagement,
+            defaultMultiBlockPolicy3D().getBlockCommunicator(),
+            defaultMultiBlockPolicy3D().getCombinedStatistics(),
+            defaultMultiBlockPolicy3D().getMultiCellAccess<T, DESCRIPTOR>(),
+            new GuoExternalForceBGKdynamics<T, DESCRIPTOR>(1.0/param::tau));
+
+  // -------------------------- Define boundary conditions ---------------------
+  OnLatticeBoundaryCondition3D<T,DESCRIPTOR>* boundaryCondition = createLocalBoundaryCondition3D<T,DESCRIPTOR>();
+  Box3D bb = hemocell.lattice->getBoundingBox();
+  Box3D bounceback_box(bb.x0+1, bb.x1-1,bb.y0+1,bb.y1-1, bb.z0, bb.z1-1);
+
+  defineDynamics(*hemocell.lattice, *flagMatrix.get(), bounceback_box, new BounceBack<T, DESCRIPTOR>(1.), 0);
+
+  // -------------------------- Define shear surface ---------------------
+  T surf_velocityLU = (*cfg)["domain"]["velocity"].read<T>()*((*cfg)["domain"]["dt"].read<T>()/(*cfg)["domain"]["dx"].read<T>()); // unit conversion from m/s to LUs
+  pcout << "(stent_strut) Surface velocity: " << surf_velocityLU << " in LU" << endl;
+
+  Box3D shear_surf( bb.x0, bb.x1, bb.y0, bb.y1, bb.z1, bb.z1 );
+
+  boundaryCondition->setVelocityConditionOnBlockBoundaries (*hemocell.lattice, shear_surf );
+  setBoundaryVelocity(*hemocell.lattice, shear_surf, plb::Array<T,3>(surf_velocityLU,0,0));
+
+  hemocell.lattice->toggleInternalStatistics(false);
+  hemocell.lattice->periodicity().toggleAll(false);
+  hemocell.lattice->periodicity().toggle(0,true);
+  hemocell.lattice->periodicity().toggle(1,true);
+  hemocell.latticeEquilibrium(1.,plb::Array<double, 3>(0.,0.,0.));
+
+  hemocell.lattice->initialize();
+}
+
+void StentBenchmark::setupCells() {
+  hemocell.initializeCellfield();
+  hemocell.addCellType<RbcHighOrderModel>("RBC", RBC_FROM_SPHERE);
+  hemocell.setMaterialTimeScaleSeparation("RBC", (*cfg)["ibm"]["stepMaterialEvery"].read<int>());
+  hemocell.setInitialMinimumDistanceFromSolid("RBC", 0.5); //Micrometer! not LU
+
+  hemocell.addCellType<PltSimpleModel>("PLT", ELLIPSOID_FROM_SPHERE);
+  hemocell.setMaterialTimeScaleSeparation("PLT", (*cfg)["ibm"]["stepMaterialEvery"].read<int>());
+  cellTypes = {"RBC", "PLT"};
+
+  hemocell.setParticleVelocityUpdateTimeScaleSeparation((*cfg)["ibm"]["stepParticleEvery"].read<int>());
+
+  vector<int> outputs = {OUTPUT_POSITION,OUTPUT_TRIANGLES,OUTPUT_FORCE,OUTPUT_FORCE_VOLUME,OUTPUT_FORCE_BENDING,OUTPUT_FORCE_LINK,OUTPUT_FORCE_AREA, OUTPUT_FORCE_VISC};
+  setOutputs("RBC", outputs);
+  setOutputs("PLT", outputs);
+
+  outputs = {OUTPUT_VELOCITY,OUTPUT_DENSITY,OUTPUT_FORCE,OUTPUT_BOUNDARY, OUTPUT_SHEAR_RATE, OUTPUT_STRAIN_RATE, OUTPUT_SHEAR_STRESS};
+  setFluidOutputs(outputs);
+}
+
+void StentBenchmark::afterIteration() {
+  BenchmarkDriver::afterIteration();
+
+  if (hemocell.iter % tcsv == 0) {
+    hlog << "Saving simple mean cell values to CSV at timestep " << hemocell.iter << endl;
+    writeCellInfo_CSV(hemocell);
+  }
+
+  if (hemocell.iter % tcheckpoint == 0) {
+    saveCheckpoint();
+  }
+}
+
+}
+}
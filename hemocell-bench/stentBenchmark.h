@@ -0,0 +1,78 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_STENTBENCHMARK_H
+#define HEMOCELL_BENCH_STENTBENCHMARK_H
+
+#include "benchmarkDriver.h"
+
+#include <memory>
+#include <string>
+
+namespace hemo {
+namespace bench {
+
+/**
+ * The stent strut case: the geometry is voxelized from <domain><geometry>
+ * (an STL file), a shear velocity is set on the top surface and the domain
+ * is periodic in x and y. RBCs and PLTs are added, the cell info is written
+ * to csv every tcsv iterations and a checkpoint is saved every tcheckpoint
+ * iterations (a differential one with <benchmark><checkpointMode> delta).
+ *
+ * The voxelized geometry is cached in <benchmark><geometryCache> (default
+ * geometry-cache, off disables it), keyed by the STL file, the domain
+ * parameters and the number of processes, so restarts skip the voxelization.
+ *
+ * With <benchmark><decomposition> sparse the blocks without fluid are
+ * dropped and the rest is attributed by fluid cells plus the expected cell
+ * load from RBC.pos and PLT.pos, see decompose().
+ */
+class StentBenchmark : public BenchmarkDriver {
+public:
+  StentBenchmark(int argc, char * argv[]);
+
+protected:
+  void buildLattice() override;
+  void setupCells() override;
+  void afterIteration() override;
+
+  /* Voxelize the STL geometry into flagMatrix and geometryManagement, or
+   * load them from the geometry cache */
+  virtual void voxelize();
+  /* Key of the geometry cache entry for this configuration */
+  std::string geometryKey();
+  /* Replace geometryManagement by the sparse decomposition if it is selected */
+  virtual void decompose();
+
+  std::auto_ptr<MultiScalarField3D<int>> flagMatrix;
+  std::auto_ptr<VoxelizedDomain3D<T>> voxelizedDomain;
+  /* Block management of the voxelized geometry, the lattice is created on it */
+  std::unique_ptr<MultiBlockManagement3D> geometryManagement;
+
+  unsigned int tcheckpoint;
+  unsigned int tcsv;
+};
+
+}
+}
+#endif
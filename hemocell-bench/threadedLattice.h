@@ -0,0 +1,71 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_THREADEDLATTICE_H
+#define HEMOCELL_BENCH_THREADEDLATTICE_H
+
+#include "palabos3D.h"
+
+#include <vector>
+
+namespace hemo {
+namespace bench {
+
+/**
+ * MultiBlockLattice3D that collides and streams the atomic blocks of this
+ * process with an OpenMP thread team. The envelope exchange and the rest of
+ * the palabos cycle are done by the calling thread only, so MPI is only
+ * used outside of parallel regions (MPI_THREAD_FUNNELED is enough).
+ *
+ * HemoCell calls lattice->collideAndStream() from iterate(), so creating
+ * hemocell.lattice as this class is all that is needed. Compile the
+ * translation unit that instantiates it with OpenMP, without it the blocks
+ * are processed serially as in palabos.
+ */
+template<typename T, template<typename U> class Descriptor>
+class ThreadedMultiBlockLattice3D : public plb::MultiBlockLattice3D<T, Descriptor> {
+public:
+  using plb::MultiBlockLattice3D<T, Descriptor>::MultiBlockLattice3D;
+
+  void collideAndStream() override {
+    std::vector<plb::plint> const & blocks = this->getMultiBlockManagement().getLocalInfo().getBlocks();
+    const long nBlocks = blocks.size();
+
+    // blocks can differ in size and fluid fraction, so hand them out one by one
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (long i = 0; i < nBlocks; i++) {
+      this->getComponent(blocks[i]).collideAndStream();
+    }
+
+    this->duplicateOverlaps(plb::modif::population);
+    this->executeInternalProcessors();
+    this->evaluateStatistics();
+    this->incrementTime();
+  }
+};
+
+}
+}
+#endif
@@ -0,0 +1,138 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "throughput.h"
+#include "particleHelpers.h"
+
+#include <algorithm>
+#include <map>
+
+#include <mpi.h>
+
+using namespace plb;
+
+namespace hemo {
+namespace bench {
+
+Throughput::Throughput(HemoCell & hemocell_, std::vector<std::string> const & cellTypes_) :
+hemocell(hemocell_), cellTypes(cellTypes_), vertices(cellTypes_.size(), 0.), vertexUpdates(cellTypes_.size(), 0.)
+{}
+
+void Throughput::update() {
+  MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+  std::map<plint, Box3D> const & bulks = management.getSparseBlockStructure().getBulks();
+
+  // a rebalance can keep the block ids, so the bulks are compared as well
+  std::vector<plint> current;
+  for (plint id : management.getLocalInfo().getBlocks()) {
+    Box3D const & bulk = bulks.at(id);
+    current.insert(current.end(), {id, bulk.x0, bulk.x1, bulk.y0, bulk.y1, bulk.z0, bulk.z1});
+  }
+  if (current == blocks) { return; }
+  blocks = current;
+
+  lattice = fluid = 0.;
+  for (plint id : management.getLocalInfo().getBlocks()) {
+    Box3D const & bulk = bulks.at(id);
+    lattice += bulk.nCells();
+
+    BlockLattice3D<T,DESCRIPTOR> & block = hemocell.lattice->getComponent(id);
+    Dot3D location = block.getLocation();
+    for (plint x = bulk.x0; x <= bulk.x1; x++) {
+      for (plint y = bulk.y0; y <= bulk.y1; y++) {
+        for (plint z = bulk.z0; z <= bulk.z1; z++) {
+          if (!block.get(x - location.x, y - location.y, z - location.z).getDynamics().isBoundary()) {
+            fluid += 1.;
+          }
+        }
+      }
+    }
+  }
+  refresh();
+}
+
+void Throughput::refresh() {
+  std::map<pluint, std::size_t> typeIndex = cellTypeIndex(hemocell, cellTypes);
+  std::fill(vertices.begin(), vertices.end(), 0.);
+
+  MultiBlockManagement3D const & management = hemocell.lattice->getMultiBlockManagement();
+  for (plint id : management.getLocalInfo().getBlocks()) {
+    Box3D const & bulk = management.getSparseBlockStructure().getBulks().at(id);
+    for (HemoCellParticle const & particle : hemocell.cellfields->immersedParticles->getComponent(id).particles) {
+      if (!inBulk(bulk, particle.sv.position)) { continue; }
+
+      auto type = typeIndex.find(particle.sv.celltype);
+      if (type != typeIndex.end()) { vertices[type->second] += 1.; }
+    }
+  }
+}
+
+void Throughput::addStep(double seconds_) {
+  update();
+  seconds += seconds_;
+  iterations++;
+  fluidUpdates += fluid;
+  for (std::size_t i = 0; i < vertices.size(); i++) {
+    vertexUpdates[i] += vertices[i];
+  }
+}
+
+void Throughput::addMetrics() {
+  const std::size_t nTypes = cellTypes.size();
+  hemo::global.statistics.addMetric("Fluid Nodes", fluid);
+  hemo::global.statistics.addMetric("Throughput Iterations", (double)iterations);
+  hemo::global.statistics.addMetric("Throughput Time", seconds);
+  hemo::global.statistics.addMetric("Fluid MLUPS", seconds > 0. ? fluidUpdates / seconds * 1e-6 : 0.);
+  for (std::size_t i = 0; i < nTypes; i++) {
+    hemo::global.statistics.addMetric(cellTypes[i] + " Vertex Updates Per Second",
+                                      seconds > 0. ? vertexUpdates[i] / seconds : 0.);
+  }
+
+  // the updates of all processes in the time of the slowest one
+  std::vector<double> updates(1 + nTypes);
+  updates[0] = fluidUpdates;
+  std::copy(vertexUpdates.begin(), vertexUpdates.end(), updates.begin() + 1);
+  MPI_Allreduce(MPI_IN_PLACE, updates.data(), updates.size(), MPI_DOUBLE, MPI_SUM,
+                plb::global::mpi().getGlobalCommunicator());
+  double slowest = seconds;
+  MPI_Allreduce(MPI_IN_PLACE, &slowest, 1, MPI_DOUBLE, MPI_MAX, plb::global::mpi().getGlobalCommunicator());
+
+  double mlups = slowest > 0. ? updates[0] / slowest * 1e-6 : 0.;
+  hemo::global.statistics.addMetric("Global Fluid MLUPS", mlups);
+  hlog << "(main) Throughput over " << iterations << " iterations: " << mlups << " fluid MLUPS";
+  for (std::size_t i = 0; i < nTypes; i++) {
+    double perSecond = slowest > 0. ? updates[1 + i] / slowest : 0.;
+    hemo::global.statistics.addMetric("Global " + cellTypes[i] + " Vertex Updates Per Second", perSecond);
+    hlog << ", " << perSecond << " " << cellTypes[i] << " vertex updates/s";
+  }
+  hlog << endl;
+}
+
+double Throughput::slowestSecondsPerIteration() const {
+  double perIteration = iterations > 0 ? seconds / iterations : 0.;
+  MPI_Allreduce(MPI_IN_PLACE, &perIteration, 1, MPI_DOUBLE, MPI_MAX, plb::global::mpi().getGlobalCommunicator());
+  return perIteration;
+}
+
+}
+}
@@ -0,0 +1,83 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEMOCELL_BENCH_THROUGHPUT_H
+#define HEMOCELL_BENCH_THROUGHPUT_H
+
+#include "hemocell.h"
+
+#include <string>
+#include <vector>
+
+namespace hemo {
+namespace bench {
+
+/**
+ * Normalised throughput of the timed loop: fluid lattice updates per second
+ * (MLUPS) and membrane vertex updates per second per cell type, per process
+ * and over all processes.
+ *
+ * The local fluid nodes (lattice points of the bulks without boundary
+ * dynamics) are counted when the local blocks change, the vertices in the
+ * bulks of the local blocks at every refresh() and also when the blocks
+ * change. Every addStep() adds them once, so only the iterations passed to
+ * it count, warmup and output are left out by the caller.
+ *
+ * The global numbers divide the updates of all processes by the loop time
+ * of the slowest process.
+ */
+class Throughput {
+public:
+  Throughput(HemoCell & hemocell, std::vector<std::string> const & cellTypes);
+
+  /* One timed iteration of seconds */
+  void addStep(double seconds);
+  /* Count the vertices again, the cells move between blocks */
+  void refresh();
+  /* Lattice points in the bulks of the local blocks, fluid or not */
+  double latticeNodes() const { return lattice; }
+  /* Collective: add the metrics to hemo::global.statistics and log the global numbers */
+  void addMetrics();
+  /* Collective: seconds per timed iteration of the slowest process, 0 without iterations */
+  double slowestSecondsPerIteration() const;
+
+private:
+  /* Count the nodes and vertices again if the local blocks changed */
+  void update();
+
+  HemoCell & hemocell;
+  std::vector<std::string> cellTypes;
+
+  std::vector<plb::plint> blocks;
+  double lattice = 0., fluid = 0.;
+  std::vector<double> vertices;
+
+  double seconds = 0.;
+  unsigned long iterations = 0;
+  double fluidUpdates = 0.;
+  std::vector<double> vertexUpdates;
+};
+
+}
+}
+#endif
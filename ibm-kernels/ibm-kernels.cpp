@@ -0,0 +1,242 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "cubeBenchmark.h"
+#include "particleLoader.h"
+
+#include "cellInfo.h"
+#include "pltSimpleModel.h"
+
+#include "palabos3D.h"
+#include "palabos3D.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <random>
+
+using namespace hemo;
+
+/* Volume of an RBC and the slot it is placed in, as in scripts/setup-experiment.py (micrometer) */
+static const double RBC_VOLUME = 90.;
+static const double RBC_SLOT[3] = {8., 4., 8.};
+
+/*
+ * The IBM kernels of HemoCell on a single atomic block, without any
+ * communication: one process, one block of the cube domain.
+ *
+ * Instead of RBC.pos the cells are generated: the fluid part of the domain
+ * is divided in slots of one RBC, <hematocrit> of the volume is filled with
+ * RBCs (RbcHighOrderModel) and <pltPerRbc> platelets (PltSimpleModel) per
+ * RBC take the next slots. The slots are shuffled with <seed>.
+ *
+ * Every repetition runs the phases of an iteration in the order of
+ * hemocell.iterate(), and each is timed on its own:
+ *  - spreadParticleForce()
+ *  - collideAndStream() (untimed, so the velocity field stays realistic)
+ *  - interpolateFluidVelocity()
+ *  - advanceParticles()
+ *  - applyConstitutiveModel(), forced every repetition
+ *  - the reset of the force field (untimed)
+ * The first <warmupRepetitions> are not recorded, tmax is the number of
+ * recorded repetitions. The median, the median absolute deviation and the
+ * extremes are reported per phase, together with the time per vertex.
+ */
+class IbmKernels : public bench::CubeBenchmark {
+public:
+  IbmKernels(int argc, char *argv[]) : bench::CubeBenchmark(argc, argv)
+  {
+    hematocrit = benchmarkOption<double>("hematocrit", 0.2);
+    pltPerRbc = benchmarkOption<double>("pltPerRbc", 0.1);
+    warmupRepetitions = benchmarkOption<unsigned int>("warmupRepetitions", 10);
+    seed = benchmarkOption<unsigned int>("seed", 1);
+    hlog << "hematocrit : " << hematocrit << ", pltPerRbc : " << pltPerRbc
+         << ", warmupRepetitions : " << warmupRepetitions << endl;
+
+    if (global::mpi().getSize() != 1) {
+      hlog << "(IbmKernels) (Error) runs on a single process, not " << global::mpi().getSize() << endl;
+      exit(1);
+    }
+    if (!scalingGrid.empty()) {
+      hlog << "(IbmKernels) (Error) the " << scalingMode << " scaling mode needs several processes, set <scaling><mode> none" << endl;
+      exit(1);
+    }
+
+    phases = {
+      {"Spread Particle Force", [this]() { hemocell.cellfields->spreadParticleForce(); }, {}},
+      {"Interpolate Fluid Velocity", [this]() { hemocell.cellfields->interpolateFluidVelocity(); }, {}},
+      {"Advance Particles", [this]() { hemocell.cellfields->advanceParticles(); }, {}},
+      {"Constitutive Model", [this]() { hemocell.cellfields->applyConstitutiveModel(true); }, {}},
+    };
+  }
+
+protected:
+  void createLattice() override {
+    // the whole domain is one atomic block
+    Box3D domain(0, nx - 1, 0, ny - 1, 0, nz - 1);
+    SparseBlockStructure3D sb(domain);
+    sb.addBlock(domain, 0);
+    createExplicitLattice(sb, {{0, 0}});
+  }
+
+  void setupCells() override {
+    bench::CubeBenchmark::setupCells();
+    hemocell.addCellType<PltSimpleModel>("PLT", ELLIPSOID_FROM_SPHERE);
+    hemocell.setMaterialTimeScaleSeparation("PLT", (*cfg)["ibm"]["stepMaterialEvery"].read<int>());
+    cellTypes.push_back("PLT");
+  }
+
+  void loadParticles() override {
+    // slots in the fluid part of the domain, the bounce back layer excluded
+    const double dx = param::dx * 1e6;
+    const double fluid[3] = {(nx - 2) * dx, (ny - 2) * dx, (nz - 2) * dx};
+    plint slots[3];
+    for (int d = 0; d < 3; d++) {
+      slots[d] = std::max<plint>(0, (plint)(fluid[d] / RBC_SLOT[d]));
+    }
+    std::vector<plint> order(slots[0] * slots[1] * slots[2]);
+    for (std::size_t i = 0; i < order.size(); i++) { order[i] = i; }
+    std::mt19937 random(seed);
+    std::shuffle(order.begin(), order.end(), random);
+
+    const std::size_t rbcs = std::lround(hematocrit * fluid[0] * fluid[1] * fluid[2] / RBC_VOLUME);
+    const std::size_t plts = std::lround(pltPerRbc * rbcs);
+    if (rbcs + plts > order.size()) {
+      hlog << "(IbmKernels) (Error) " << rbcs << " RBCs and " << plts << " PLTs do not fit in the " << order.size()
+           << " slots of the domain, the maximum hematocrit is "
+           << order.size() * RBC_VOLUME / (fluid[0] * fluid[1] * fluid[2]) / (1. + pltPerRbc) << endl;
+      exit(1);
+    }
+
+    std::vector<CellPositions> positions(2);
+    for (std::size_t i = 0; i < rbcs + plts; i++) {
+      plint slot = order[i];
+      float x = dx + (slot / (slots[1] * slots[2]) + 0.5) * RBC_SLOT[0];
+      float y = dx + ((slot / slots[2]) % slots[1] + 0.5) * RBC_SLOT[1];
+      float z = dx + (slot % slots[2] + 0.5) * RBC_SLOT[2];
+      CellPositions & type = positions[i < rbcs ? 0 : 1];
+      type.push_back(x, y, z, 0., 0., 0., type.size());
+    }
+    hlog << "(IbmKernels) generated " << rbcs << " RBCs and " << plts << " PLTs in " << order.size() << " slots" << endl;
+    loadParticlesScattered(hemocell, cellTypes, positions);
+  }
+
+  void beforeLoop() override {
+    bench::CubeBenchmark::beforeLoop();
+
+    // there is one block and no periodicity, so every particle is a vertex of a complete cell
+    std::vector<HemoCellParticle> const & particles = hemocell.cellfields->immersedParticles->getComponent(0).particles;
+    for (std::string const & type : cellTypes) {
+      const pluint ctype = (*hemocell.cellfields)[type]->ctype;
+      double count = std::count_if(particles.begin(), particles.end(),
+                                   [ctype](HemoCellParticle const & p) { return p.sv.celltype == ctype; });
+      int cells = CellInformationFunctionals::getNumberOfCellsFromType(&hemocell, type);
+      hemo::global.statistics.addMetric("IBM " + type + " Cells", (double)cells);
+      hemo::global.statistics.addMetric("IBM " + type + " Vertices", count);
+      hlog << "(IbmKernels) " << type << ": " << cells << " cells, " << count << " vertices" << endl;
+      vertices += count;
+    }
+    const double fluid = (nx - 2) * (ny - 2) * (nz - 2) * std::pow(param::dx * 1e6, 3);
+    hemo::global.statistics.addMetric("IBM Hematocrit",
+        CellInformationFunctionals::getNumberOfCellsFromType(&hemocell, "RBC") * RBC_VOLUME / fluid);
+
+    for (unsigned int i = 0; i < warmupRepetitions; i++) {
+      repetition(false);
+    }
+  }
+
+  /* One repetition instead of an iteration */
+  void step() override {
+    repetition(true);
+    hemocell.iter++;
+  }
+
+  void repetition(bool record) {
+    runPhase(phases[0], record);
+    hemocell.lattice->collideAndStream();
+    runPhase(phases[1], record);
+    runPhase(phases[2], record);
+    runPhase(phases[3], record);
+    setExternalVector(*hemocell.lattice, hemocell.lattice->getBoundingBox(),
+                      DESCRIPTOR<T>::ExternalField::forceBeginsAt,
+                      plb::Array<T, DESCRIPTOR<T>::d>(0.0, 0.0, 0.0));
+  }
+
+  struct Phase {
+    std::string name;
+    std::function<void()> run;
+    std::vector<double> seconds;
+  };
+
+  void runPhase(Phase & phase, bool record) {
+    double start = MPI_Wtime();
+    phase.run();
+    double seconds = MPI_Wtime() - start;
+    if (record) { phase.seconds.push_back(seconds); }
+  }
+
+  void finish() override {
+    hlog << "(IbmKernels) " << vertices << " vertices, " << phases[0].seconds.size() << " repetitions (seconds):" << endl;
+    hlog << "\t" << std::setw(28) << std::left << "phase" << std::right << std::setw(12) << "median"
+         << std::setw(12) << "mad" << std::setw(12) << "min" << std::setw(12) << "max"
+         << std::setw(14) << "ns/vertex" << endl;
+    for (Phase const & phase : phases) {
+      std::vector<double> values = phase.seconds;
+      if (values.empty()) { continue; }
+      std::sort(values.begin(), values.end());
+      double med = median(values);
+      std::vector<double> deviations;
+      for (double value : values) { deviations.push_back(std::fabs(value - med)); }
+      std::sort(deviations.begin(), deviations.end());
+      double mad = median(deviations);
+      double perVertex = vertices > 0. ? med / vertices : 0.;
+
+      hemo::global.statistics.addMetric("IBM " + phase.name + " Median", med);
+      hemo::global.statistics.addMetric("IBM " + phase.name + " MAD", mad);
+      hemo::global.statistics.addMetric("IBM " + phase.name + " Min", values.front());
+      hemo::global.statistics.addMetric("IBM " + phase.name + " Max", values.back());
+      hemo::global.statistics.addMetric("IBM " + phase.name + " Per Vertex", perVertex);
+      hlog << "\t" << std::setw(28) << std::left << phase.name << std::right << std::setw(12) << med
+           << std::setw(12) << mad << std::setw(12) << values.front() << std::setw(12) << values.back()
+           << std::setw(14) << perVertex * 1e9 << endl;
+    }
+
+    bench::CubeBenchmark::finish();
+  }
+
+  /* Median of sorted values */
+  static double median(std::vector<double> const & values) {
+    std::size_t n = values.size();
+    return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+  }
+
+  double hematocrit, pltPerRbc;
+  unsigned int warmupRepetitions, seed;
+  std::vector<Phase> phases;
+  double vertices = 0.;
+};
+
+int main(int argc, char *argv[]) {
+  return bench::runBenchmark<IbmKernels>(argc, argv);
+}
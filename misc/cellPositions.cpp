@@ -0,0 +1,188 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "cellPositions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hemo {
+
+namespace {
+const char MAGIC[8] = {'H', 'C', 'P', 'O', 'S', 'B', '\0', '\0'};
+
+bool inside(float x, float y, float z, float const lo[3], float const hi[3]) {
+  return x >= lo[0] && x <= hi[0] && y >= lo[1] && y <= hi[1] && z >= lo[2] && z <= hi[2];
+}
+
+bool endsWith(std::string const & s, std::string const & suffix) {
+  return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+}
+
+void CellPositions::reserve(std::size_t n) {
+  x.reserve(n); y.reserve(n); z.reserve(n);
+  rx.reserve(n); ry.reserve(n); rz.reserve(n);
+  id.reserve(n);
+}
+
+void CellPositions::push_back(float x_, float y_, float z_, float rx_, float ry_, float rz_, std::uint32_t id_) {
+  x.push_back(x_); y.push_back(y_); z.push_back(z_);
+  rx.push_back(rx_); ry.push_back(ry_); rz.push_back(rz_);
+  id.push_back(id_);
+}
+
+CellPositions readPos(std::string const & filename) {
+  std::ifstream in(filename);
+  if (!in.is_open()) {
+    throw std::runtime_error("(CellPositions) (Error) cannot open " + filename);
+  }
+
+  CellPositions cells;
+  std::size_t count = 0;
+  in >> count;
+  cells.reserve(count);
+
+  float x, y, z, rx, ry, rz;
+  for (std::size_t i = 0; i < count && (in >> x >> y >> z >> rx >> ry >> rz); i++) {
+    cells.push_back(x, y, z, rx, ry, rz, i);
+  }
+  return cells;
+}
+
+PosbFile::PosbFile(std::string const & filename_) : filename(filename_) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("(CellPositions) (Error) cannot open " + filename);
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (std::size_t)info.st_size < sizeof(Header)) {
+    close(fd);
+    throw std::runtime_error("(CellPositions) (Error) " + filename + " is not a .posb file");
+  }
+  length = info.st_size;
+  mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    mapping = nullptr;
+    throw std::runtime_error("(CellPositions) (Error) cannot map " + filename);
+  }
+
+  head = static_cast<Header const *>(mapping);
+  const std::size_t n = head->count;
+  std::size_t cells = (std::size_t)head->grid[0] * head->grid[1] * head->grid[2];
+  std::size_t idEnd = sizeof(Header) + 6 * n * sizeof(float) + n * sizeof(std::uint32_t);
+  std::size_t indexStart = (idEnd + 7) / 8 * 8;
+  std::size_t expected = indexed() ? indexStart + (cells + 1) * sizeof(std::uint64_t) : idEnd;
+
+  if (std::memcmp(head->magic, MAGIC, sizeof(MAGIC)) != 0 || head->version != 1 || length < expected) {
+    munmap(mapping, length);
+    mapping = nullptr;
+    throw std::runtime_error("(CellPositions) (Error) " + filename + " is not a valid .posb file");
+  }
+
+  char const * base = static_cast<char const *>(mapping);
+  float const * data = reinterpret_cast<float const *>(base + sizeof(Header));
+  x = data; y = x + n; z = y + n;
+  rx = z + n; ry = rx + n; rz = ry + n;
+  id = reinterpret_cast<std::uint32_t const *>(rz + n);
+  if (indexed()) {
+    start = reinterpret_cast<std::uint64_t const *>(base + indexStart);
+  }
+}
+
+PosbFile::~PosbFile() {
+  if (mapping) { munmap(mapping, length); }
+}
+
+void PosbFile::append(CellPositions & out, std::size_t i) const {
+  out.push_back(x[i], y[i], z[i], rx[i], ry[i], rz[i], id[i]);
+}
+
+CellPositions PosbFile::all() const {
+  CellPositions out;
+  out.reserve(size());
+  for (std::size_t i = 0; i < size(); i++) { append(out, i); }
+  return out;
+}
+
+CellPositions PosbFile::select(float const lo[3], float const hi[3]) const {
+  CellPositions out;
+
+  if (!indexed()) {
+    for (std::size_t i = 0; i < size(); i++) {
+      if (inside(x[i], y[i], z[i], lo, hi)) { append(out, i); }
+    }
+    return out;
+  }
+
+  // range of buckets overlapping the box along every axis, in double
+  // precision and clamped into the grid like scripts/pos-to-posb.py does,
+  // so a cell at max is found in the last bucket
+  std::uint32_t first[3], last[3];
+  for (int d = 0; d < 3; d++) {
+    if (lo[d] > head->max[d] || hi[d] < head->min[d]) { return out; }
+    double extent = (double)head->max[d] - head->min[d];
+    double width = extent > 0 ? extent / head->grid[d] : 1.;
+    long from = (long)std::floor(((double)lo[d] - head->min[d]) / width);
+    long to = (long)std::floor(((double)hi[d] - head->min[d]) / width);
+    first[d] = std::min((long)head->grid[d] - 1, std::max(0l, from));
+    last[d] = std::max(0l, std::min((long)head->grid[d] - 1, to));
+  }
+
+  for (std::uint32_t bx = first[0]; bx <= last[0]; bx++) {
+    for (std::uint32_t by = first[1]; by <= last[1]; by++) {
+      // buckets along z are consecutive in the file
+      std::size_t row = ((std::size_t)bx * head->grid[1] + by) * head->grid[2];
+      for (std::size_t i = start[row + first[2]]; i < start[row + last[2] + 1]; i++) {
+        if (inside(x[i], y[i], z[i], lo, hi)) { append(out, i); }
+      }
+    }
+  }
+  return out;
+}
+
+CellPositions readCellPositions(std::string const & filename, float const lo[3], float const hi[3]) {
+  if (endsWith(filename, ".posb")) {
+    return PosbFile(filename).select(lo, hi);
+  }
+
+  CellPositions all = readPos(filename);
+  CellPositions out;
+  for (std::size_t i = 0; i < all.size(); i++) {
+    if (inside(all.x[i], all.y[i], all.z[i], lo, hi)) {
+      out.push_back(all.x[i], all.y[i], all.z[i], all.rx[i], all.ry[i], all.rz[i], all.id[i]);
+    }
+  }
+  return out;
+}
+
+}
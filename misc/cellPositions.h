@@ -0,0 +1,119 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CELLPOSITIONS_H
+#define CELLPOSITIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hemo {
+
+/**
+ * Initial cell positions (in micrometer) and rotations (in degrees) as
+ * found in a .pos file, stored as structure of arrays. id is the index of
+ * the cell in the original .pos file, HemoCell numbers the cells by it, so
+ * a subset of the cells must keep it.
+ */
+struct CellPositions {
+  std::vector<float> x, y, z;
+  std::vector<float> rx, ry, rz;
+  std::vector<std::uint32_t> id;
+
+  std::size_t size() const { return x.size(); }
+  void reserve(std::size_t n);
+  void push_back(float x_, float y_, float z_, float rx_, float ry_, float rz_, std::uint32_t id_);
+};
+
+/* Parse a text .pos file: the number of cells followed by a line
+ * "x y z rx ry rz" per cell */
+CellPositions readPos(std::string const & filename);
+
+/**
+ * Read only view of a binary .posb file, the file is memory mapped so only
+ * the pages that are accessed are read from disk.
+ *
+ * Layout (native byte order, see scripts/pos-to-posb.py):
+ *  - Header, 64 bytes:
+ *    char[8] magic "HCPOSB\0\0", uint32 version, uint32 flags (1: indexed),
+ *    uint64 number of cells, float32[3] minimum and float32[3] maximum
+ *    position, uint32[3] index grid, uint32 reserved
+ *  - float32 x[n], y[n], z[n], rx[n], ry[n], rz[n]
+ *  - uint32 id[n], padded to 8 bytes
+ *  - if indexed: uint64 start[gx * gy * gz + 1], the cells are sorted by
+ *    the grid bucket (x major, z fastest) their position falls in, bucket
+ *    b holds the cells start[b] up to start[b + 1]
+ *
+ * Every array starts at a fixed offset, so selecting the cells in a box only
+ * touches the buckets that overlap it.
+ */
+class PosbFile {
+public:
+  struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::uint64_t count;
+    float min[3];
+    float max[3];
+    std::uint32_t grid[3];
+    std::uint32_t reserved;
+  };
+  static const std::uint32_t INDEXED = 1;
+
+  /* Throws std::runtime_error if the file cannot be mapped or is not a .posb file */
+  explicit PosbFile(std::string const & filename);
+  ~PosbFile();
+  PosbFile(PosbFile const &) = delete;
+  PosbFile & operator=(PosbFile const &) = delete;
+
+  Header const & header() const { return *head; }
+  std::size_t size() const { return head->count; }
+  bool indexed() const { return head->flags & INDEXED; }
+
+  /* All cells whose position lies within [lo, hi] (micrometer, inclusive) */
+  CellPositions select(float const lo[3], float const hi[3]) const;
+  /* All cells */
+  CellPositions all() const;
+
+private:
+  void append(CellPositions & out, std::size_t i) const;
+
+  std::string filename;
+  void * mapping = nullptr;
+  std::size_t length = 0;
+  Header const * head;
+  float const * x, * y, * z, * rx, * ry, * rz;
+  std::uint32_t const * id;
+  std::uint64_t const * start = nullptr;
+};
+
+/* The cells of a .posb or .pos file (by extension) that lie within [lo, hi],
+ * only a .posb file is read without parsing every cell */
+CellPositions readCellPositions(std::string const & filename, float const lo[3], float const hi[3]);
+
+}
+#endif /* CELLPOSITIONS_H */
@@ -24,129 +24,324 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 #include "profiler.h"
-#include <limits.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <sstream>
+
+#if defined(HEMO_PROFILER_TSC) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+#if defined(HEMO_PROFILER_PERF) && defined(__linux__)
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define HEMO_PROFILER_PERF_EVENTS
+#endif
 
 #include "parallelism/mpiManager.h"
+#include <mpi.h>
 
 namespace hemo {
-  
+
 Profiler::Profiler(std::string name_) :
-name(name_), parent(*this), current(this)
-{}
+name(name_), parent(nullptr), root(this), id(0), registry(new Registry())
+{
+  /* Preallocate, HemoCell itself uses a few dozen timers */
+  registry->nodes.reserve(256);
+  registry->byId.reserve(256);
+  registry->state.reserve(256);
+  registry->counters.reserve(256);
+  registry->byId.push_back(this);
+  registry->state.emplace_back();
+  registry->counters.emplace_back();
+  registry->counterSlot.fill(-1);
+  registry->created_ticks = now();
+  registry->created_time = std::chrono::steady_clock::now();
+}
 
-Profiler::Profiler(std::string name_, Profiler & parent_) :
-name(name_), parent(parent_)
+Profiler::Profiler(std::string name_, Profiler & parent_, TimerId id_) :
+name(name_), parent(&parent_), root(parent_.root), id(id_)
 {}
 
+Profiler::Profiler(Profiler && other) :
+name(other.name), timers(std::move(other.timers)), metrics(std::move(other.metrics)),
+numericMetrics(std::move(other.numericMetrics)),
+parent(other.parent), root(other.isRoot() ? this : other.root), id(other.id),
+registry(std::move(other.registry)), current(other.current == &other ? this : other.current)
+{
+  if (registry) {
+    registry->byId[id] = this;
+    for (std::unique_ptr<Profiler> & node : registry->nodes) {
+      node->root = this;
+      if (node->parent == &other) { node->parent = this; }
+    }
+  }
+}
+
+Profiler::Registry::~Registry() {
+#ifdef HEMO_PROFILER_PERF_EVENTS
+  for (int fd : counterFds) {
+    close(fd);
+  }
+#endif
+}
+
+Profiler::tick_t Profiler::now() {
+#if defined(HEMO_PROFILER_TSC) && (defined(__x86_64__) || defined(__i386__))
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+double Profiler::secondsPerTick() {
+#if defined(HEMO_PROFILER_TSC) && (defined(__x86_64__) || defined(__i386__))
+  /* Calibrate against the steady clock over the whole lifetime of the root */
+  Registry & reg = *root->registry;
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - reg.created_time).count();
+  tick_t passed = now() - reg.created_ticks;
+  return passed ? seconds / passed : 0.0;
+#else
+  return double(std::chrono::steady_clock::period::num) / std::chrono::steady_clock::period::den;
+#endif
+}
+
+double Profiler::ticksToSeconds(tick_t ticks) {
+  return ticks * secondsPerTick();
+}
+
+std::chrono::high_resolution_clock::duration Profiler::ticksToDuration(tick_t ticks) {
+  return std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double>(ticksToSeconds(ticks)));
+}
+
 void Profiler::start() {
-  if (started) {
+  TimerState & s = state();
+  if (s.started) {
     hemo::hlog << "(Profiler) (Warning) Timer " << name << " has already been started" << std::endl;
   } else {
-    //Not root node and parent not started
-    if (&parent != this && !parent.started) {
-      hemo::hlog << "(Profiler) (Warning) Starting timer " << name << " but parent has not been started, starting it for now but you should fix this in the code " << std::endl;
-      parent.start();
-    }
-    start_time = std::chrono::high_resolution_clock::now();
-    started = true;
-  }
-  
-  //Check siblings for started
-  for (std::pair<const std::string,Profiler> & timer_pair : parent.timers) {
-    Profiler & timer = timer_pair.second;
-    if (&timer == this) {continue;}
-    if (timer.started) {
-      hemo::hlog << "(Profiler) (Warning) Starting timer " << name << " but sibling " << timer.name << " has also been started, starting it for now but you should fix this in the code " << std::endl;
+    if (!isRoot()) {
+      //Not root node and parent not started
+      if (!parent->state().started) {
+        hemo::hlog << "(Profiler) (Warning) Starting timer " << name << " but parent has not been started, starting it for now but you should fix this in the code " << std::endl;
+        parent->start();
+      }
+
+      //A running sibling is known from the counter, only search it for the warning
+      if (parent->state().running_children > 0) {
+        for (std::pair<std::uint32_t,Profiler *> & timer_pair : parent->timers) {
+          Profiler & timer = *timer_pair.second;
+          if (timer.state().started) {
+            hemo::hlog << "(Profiler) (Warning) Starting timer " << name << " but sibling " << timer.name << " has also been started, starting it for now but you should fix this in the code " << std::endl;
+          }
+        }
+      }
+      parent->state().running_children++;
     }
+    s.started = true;
+    s.start = now();
+    if (counting()) { root->registry->counters[id].start = readCounters(); }
   }
-  
+
   //Set current
-  current = this;
-  Profiler * root = this;
-  do  {
-    root = &root->parent;
-    root->current = this;
-  } while (root != &root->parent);  
+  root->current = this;
 }
 
 void Profiler::stop_nowarn() {
-  if (started)
+  TimerState & s = state();
+  if (s.started)
   {
-    std::chrono::high_resolution_clock::time_point stop_time = std::chrono::high_resolution_clock::now();
-    total_time = total_time + (stop_time - start_time);
-    started = false;
+    s.total += now() - s.start;
+    if (counting()) { addCounters(); }
+    s.calls++;
+    s.started = false;
+    if (!isRoot()) { parent->state().running_children--; }
   }
-  
-  //Stop all child timers
-  for (std::pair<const std::string,Profiler> & timer_pair : timers) {
-    Profiler & timer = timer_pair.second;
-    timer.stop_nowarn();
+
+  //Stop all running child timers
+  if (s.running_children > 0) {
+    for (std::pair<std::uint32_t,Profiler *> & timer_pair : timers) {
+      timer_pair.second->stop_nowarn();
+    }
   }
 }
 
 void Profiler::stop() {
-  if (!started) {
+  tick_t stop_time = now();
+  TimerState & s = state();
+  if (!s.started) {
     hemo::hlog << "(Profiler) (Warning) Timer " << name << " has not been started" << std::endl;
   } else {
-    std::chrono::high_resolution_clock::time_point stop_time = std::chrono::high_resolution_clock::now();
-    total_time = total_time + (stop_time - start_time);
-    started = false;
+    s.total += stop_time - s.start;
+    if (counting()) { addCounters(); }
+    s.calls++;
+    s.started = false;
+    if (!isRoot()) { parent->state().running_children--; }
   }
-  
-  //Stop all child timers
-  for (std::pair<const std::string,Profiler> & timer_pair : timers) {
-    Profiler & timer = timer_pair.second;
-    timer.stop_nowarn();
+
+  //Stop all running child timers
+  if (s.running_children > 0) {
+    for (std::pair<std::uint32_t,Profiler *> & timer_pair : timers) {
+      timer_pair.second->stop_nowarn();
+    }
   }
-  
+
   //Adjust current timer
-  current = &parent;
-  Profiler * root = this;
-  do  {
-    root = &root->parent;
-    root->current = &parent;
-  } while (root != &root->parent);  
+  root->current = isRoot() ? this : parent;
 }
 
 void Profiler::reset() {
-  started = false;
-  total_time = std::chrono::high_resolution_clock::duration::zero();
-  
-  //Reset all child timers
-  for (std::pair<const std::string,Profiler> & timer_pair : timers) {
-    Profiler & timer = timer_pair.second;
-    timer.reset();
+  //Reset all child timers first, a running child still decrements our running_children
+  for (std::pair<std::uint32_t,Profiler *> & timer_pair : timers) {
+    timer_pair.second->reset();
   }
+
+  TimerState & s = state();
+  if (s.started && !isRoot()) { parent->state().running_children--; }
+  s = TimerState();
+  root->registry->counters[id] = CounterState();
 }
 
 std::chrono::high_resolution_clock::duration Profiler::elapsed() {
-  if (!started) {
-    return total_time;
+  TimerState & s = state();
+  if (!s.started) {
+    return ticksToDuration(s.total);
   } else {
-    return total_time + (std::chrono::high_resolution_clock::now() - start_time);
+    return ticksToDuration(s.total + (now() - s.start));
   }
 }
 
 std::string Profiler::elapsed_string() {
-  if (!started) {
-    return std::to_string(((double)std::chrono::duration_cast<std::chrono::milliseconds>(total_time).count())/1000.0);
-  } else {
-    return std::to_string(((double)std::chrono::duration_cast<std::chrono::milliseconds>(total_time+(std::chrono::high_resolution_clock::now() - start_time)).count())/1000.0);
+  return std::to_string(((double)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed()).count())/1000.0);
+}
+
+std::uint64_t Profiler::calls() {
+  return state().calls;
+}
+
+double Profiler::totalSeconds(const std::string & name_) {
+  double seconds = 0.;
+  for (Profiler * timer : root->registry->byId) {
+    if (timer->name == name_) {
+      seconds += std::chrono::duration<double>(timer->elapsed()).count();
+    }
   }
+  return seconds;
+}
+
+bool Profiler::enableCounters() {
+  Registry & reg = *root->registry;
+  if (reg.counterLeader >= 0) { return true; }
+#ifdef HEMO_PROFILER_PERF_EVENTS
+  static const std::uint64_t events[N_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                   PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+  /* One group, so all counters are read with a single read() */
+  int leader = -1, error = 0;
+  for (int c = 0; c < N_COUNTERS; c++) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = events[c];
+    attr.disabled = leader < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+    if (fd < 0) {
+      error = errno;
+      continue;
+    }
+    if (leader < 0) { leader = fd; }
+    reg.counterSlot[c] = reg.counterFds.size();
+    reg.counterFds.push_back(fd);
+  }
+  if (leader < 0) {
+    hemo::hlog << "(Profiler) (Warning) Hardware counters are not available (perf_event_open: " << std::strerror(error)
+               << "), check /proc/sys/kernel/perf_event_paranoid" << std::endl;
+    return false;
+  }
+  ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  reg.counterLeader = leader;
+
+  /* Timers that are running now count from here */
+  HardwareCounters values = readCounters();
+  reg.counters.resize(reg.state.size());
+  for (std::size_t i = 0; i < reg.state.size(); i++) {
+    if (reg.state[i].started) { reg.counters[i].start = values; }
+  }
+  return true;
+#else
+  hemo::hlog << "(Profiler) (Warning) Hardware counters are not available, compile with -DHEMO_PROFILER_PERF on Linux" << std::endl;
+  return false;
+#endif
+}
+
+bool Profiler::countersEnabled() {
+  return counting();
+}
+
+bool Profiler::counterAvailable(Counter counter) {
+  return root->registry->counterSlot[counter] >= 0;
+}
+
+Profiler::HardwareCounters Profiler::readCounters() {
+  HardwareCounters values = {};
+#ifdef HEMO_PROFILER_PERF_EVENTS
+  Registry & reg = *root->registry;
+  if (reg.counterLeader < 0) { return values; }
+  /* PERF_FORMAT_GROUP: the number of counters followed by their values */
+  std::uint64_t buffer[1 + N_COUNTERS];
+  if (read(reg.counterLeader, buffer, sizeof(buffer)) <= 0) { return values; }
+  for (int c = 0; c < N_COUNTERS; c++) {
+    int slot = reg.counterSlot[c];
+    if (slot >= 0 && std::uint64_t(slot) < buffer[0]) { values[c] = buffer[1 + slot]; }
+  }
+#endif
+  return values;
+}
+
+void Profiler::addCounters() {
+  CounterState & c = root->registry->counters[id];
+  HardwareCounters values = readCounters();
+  for (int k = 0; k < N_COUNTERS; k++) {
+    c.total[k] += values[k] - c.start[k];
+  }
+}
+
+Profiler::HardwareCounters Profiler::counters() {
+  CounterState & c = root->registry->counters[id];
+  HardwareCounters values = c.total;
+  if (counting() && state().started) {
+    HardwareCounters current = readCounters();
+    for (int k = 0; k < N_COUNTERS; k++) {
+      values[k] += current[k] - c.start[k];
+    }
+  }
+  return values;
+}
+
+std::vector<Profiler *> Profiler::sortedTimers() {
+  std::vector<Profiler *> sorted;
+  for (std::pair<std::uint32_t,Profiler *> & timer_pair : timers) {
+    sorted.push_back(timer_pair.second);
+  }
+  std::sort(sorted.begin(), sorted.end(), [](Profiler * a, Profiler * b) { return a->name < b->name; });
+  return sorted;
 }
 
 template<typename T>
 void Profiler::printStatistics_inner(int level, T & out) {
-  if (!started) {
-    out << std::string(level,' ') << name << ": " << std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(total_time).count()/1000.0) << std::endl;
-  } else {
-    out << std::string(level,' ') << name << ": " << 
-           std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(total_time + (std::chrono::high_resolution_clock::now() - start_time)).count()/1000.0) << std::endl;
-  }
+  out << std::string(level,' ') << name << ": " << toString(elapsed()) << std::endl;
   //Print all child timers
-  for (std::pair<const std::string,Profiler> & timer_pair : timers) {
-    Profiler & timer = timer_pair.second;
-    timer.printStatistics_inner(level+1, out);
+  for (Profiler * timer : sortedTimers()) {
+    timer->printStatistics_inner(level+1, out);
   }
 }
 
@@ -164,30 +359,44 @@ void Profiler::printMetrics_JSON(T & out) {
   out << "}";
 }
 
+template<typename T>
+void Profiler::printCounters_JSON(T & out) {
+  static const char * const counterNames[N_COUNTERS] = {"Cycles", "Instructions", "LLC Misses", "Branch Misses"};
+
+  HardwareCounters values = counters();
+  for (int c = 0; c < N_COUNTERS; c++) {
+    if (counterAvailable(Counter(c))) {
+      out << ",\"" << counterNames[c] << "\":" << values[c];
+    }
+  }
+  if (counterAvailable(CYCLES) && counterAvailable(INSTRUCTIONS) && values[CYCLES] > 0) {
+    out << ",\"IPC\":" << double(values[INSTRUCTIONS]) / values[CYCLES];
+  }
+}
+
 template<typename T>
 void Profiler::printStatistics_JSON(T & out) {
 
-  if(started) this->stop_nowarn();
+  if(state().started) this->stop_nowarn();
 
-  /* If has children current timer has children, print as object */
-  if( timers.size() > 0 ) {
+  /* If has children current timer has children (or counters), print as object */
+  if( timers.size() > 0 || counting() ) {
     // Print as element with children
 
-    /* Begin new object and add total timer > { "Name" : { "Total": xx, $CHILDREN}} */
-    out << "\"" << name << "\":{\"Total\":" << std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(total_time).count()/1000.0);
+    /* Begin new object and add total timer > { "Name" : { "Total": xx, $COUNTERS, $CHILDREN}} */
+    out << "\"" << name << "\":{\"Total\":" << toString(elapsed());
+    if (counting()) { printCounters_JSON(out); }
 
     /* Output Childtimers */
-    for (std::pair<const std::string,Profiler> & timer_pair : timers) {
+    for (Profiler * timer : sortedTimers()) {
       out << ",";
-
-      Profiler & timer = timer_pair.second;
-      timer.printStatistics_JSON(out);
+      timer->printStatistics_JSON(out);
     }
 
     out << "}";
   } else {
     /* If timer does not have childres, print; "NAMA": xxx */
-    out << "\"" << name << "\":" << std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(total_time).count()/1000.0);
+    out << "\"" << name << "\":" << toString(elapsed());
   }
 }
 
@@ -200,77 +409,370 @@ void Profiler::addMetric(std::string name, std::string data){
   metrics[name] = data;
 }
 
+void Profiler::addMetric(std::string name, double data){
+  std::ostringstream value;
+  value << data;
+  metrics[name] = value.str();
+  numericMetrics[name] = data;
+}
+
+namespace {
+/* Packed per-timer sample, reduced with a single MPI_Reduce */
+struct ImbalanceSample {
+  double sum;
+  double sumsq;
+  double min;
+  double max;
+  double maxRank;
+  double processes;
+};
+
+/* Names as one newline separated string, for sending */
+std::string joinNames(std::set<std::string> const & names) {
+  std::string joined;
+  for (std::string const & name : names) {
+    joined += name + "\n";
+  }
+  return joined;
+}
+
+void splitNames(std::string const & joined, std::set<std::string> & names) {
+  std::istringstream stream(joined);
+  for (std::string name; std::getline(stream, name); ) {
+    names.insert(name);
+  }
+}
+
+void reduceImbalanceSamples(void * invec, void * inoutvec, int * len, MPI_Datatype *) {
+  ImbalanceSample * in = static_cast<ImbalanceSample *>(invec);
+  ImbalanceSample * inout = static_cast<ImbalanceSample *>(inoutvec);
+  for (int i = 0; i < *len; i++) {
+    inout[i].sum += in[i].sum;
+    inout[i].sumsq += in[i].sumsq;
+    inout[i].min = std::min(inout[i].min, in[i].min);
+    inout[i].processes += in[i].processes;
+    if (in[i].max > inout[i].max || (in[i].max == inout[i].max && in[i].maxRank < inout[i].maxRank)) {
+      inout[i].max = in[i].max;
+      inout[i].maxRank = in[i].maxRank;
+    }
+  }
+}
+}
+
+std::vector<Profiler::ImbalanceStatistics> Profiler::computeImbalance() {
+  Registry & reg = *root->registry;
+  int rank = plb::global::mpi().getRank();
+  int size = plb::global::mpi().getSize();
+  MPI_Comm comm = plb::global::mpi().getGlobalCommunicator();
+
+  /* Agree on the quantities: the union of those of all processes, as a
+   * timer or metric can exist on only some of them. The sets are merged
+   * pairwise along a binary tree towards process 0, so every message holds
+   * the distinct names only, and process 0 broadcasts the result. */
+  std::set<std::string> names;
+  for (Profiler * timer : reg.byId) {
+    names.insert(timer->path());
+  }
+  for (std::pair<const std::string,double> & metric : numericMetrics) {
+    names.insert("Metrics/" + metric.first);
+  }
+  for (int step = 1; step < size; step *= 2) {
+    if (rank % (2 * step) == step) {
+      std::string joined = joinNames(names);
+      unsigned long long length = joined.size();
+      MPI_Send(&length, 1, MPI_UNSIGNED_LONG_LONG, rank - step, 0, comm);
+      MPI_Send(&joined[0], length, MPI_CHAR, rank - step, 1, comm);
+      break;
+    }
+    if (rank % (2 * step) == 0 && rank + step < size) {
+      unsigned long long length;
+      MPI_Recv(&length, 1, MPI_UNSIGNED_LONG_LONG, rank + step, 0, comm, MPI_STATUS_IGNORE);
+      std::string joined(length, '\0');
+      MPI_Recv(&joined[0], length, MPI_CHAR, rank + step, 1, comm, MPI_STATUS_IGNORE);
+      splitNames(joined, names);
+    }
+  }
+  std::string joined = rank == 0 ? joinNames(names) : std::string();
+  unsigned long long length = joined.size();
+  MPI_Bcast(&length, 1, MPI_UNSIGNED_LONG_LONG, 0, comm);
+  joined.resize(length);
+  MPI_Bcast(&joined[0], length, MPI_CHAR, 0, comm);
+  names.clear();
+  splitNames(joined, names);
+
+  /* the same order on every process: the timers, then the metrics, both sorted */
+  std::vector<std::string> quantities;
+  for (std::string const & name_ : names) {
+    if (name_.compare(0, 8, "Metrics/") != 0) { quantities.push_back(name_); }
+  }
+  for (std::string const & name_ : names) {
+    if (name_.compare(0, 8, "Metrics/") == 0) { quantities.push_back(name_); }
+  }
+
+  std::map<std::string,double> local;
+  for (Profiler * timer : reg.byId) {
+    local[timer->path()] = std::chrono::duration<double>(timer->elapsed()).count();
+  }
+  for (std::pair<const std::string,double> & metric : numericMetrics) {
+    local["Metrics/" + metric.first] = metric.second;
+  }
+
+  /* a process without the quantity counts as 0 */
+  std::vector<ImbalanceSample> samples;
+  for (std::string const & name_ : quantities) {
+    std::map<std::string,double>::iterator found = local.find(name_);
+    double value = found == local.end() ? 0.0 : found->second;
+    samples.push_back({value, value * value, value, value, double(rank), found == local.end() ? 0.0 : 1.0});
+  }
+
+  MPI_Datatype sampleType;
+  MPI_Type_contiguous(6, MPI_DOUBLE, &sampleType);
+  MPI_Type_commit(&sampleType);
+  MPI_Op sampleOp;
+  MPI_Op_create(&reduceImbalanceSamples, 1, &sampleOp);
+
+  std::vector<ImbalanceSample> reduced(samples.size());
+  MPI_Reduce(samples.data(), reduced.data(), samples.size(), sampleType, sampleOp, 0, comm);
+
+  MPI_Op_free(&sampleOp);
+  MPI_Type_free(&sampleType);
+
+  std::vector<ImbalanceStatistics> result;
+  if (rank != 0) { return result; }
+
+  for (std::size_t i = 0; i < quantities.size(); i++) {
+    ImbalanceSample & r = reduced[i];
+    double mean = r.sum / size;
+    double variance = std::max(0.0, r.sumsq / size - mean * mean);
+    double imbalance = mean > 0.0 ? (r.max / mean - 1.0) * 100.0 : 0.0;
+    result.push_back({quantities[i], r.min, r.max, mean, std::sqrt(variance), imbalance, int(r.maxRank), int(r.processes)});
+  }
+  return result;
+}
+
+void Profiler::printImbalance() {
+  std::vector<ImbalanceStatistics> statistics = computeImbalance();
+  if (plb::global::mpi().getRank() != 0) { return; }
+
+  hemo::hlog << "Hemocell Profiler Load Imbalance (" << plb::global::mpi().getSize() << " processes):" << std::endl;
+  char line[512];
+  std::snprintf(line, sizeof(line), "%-48s %12s %12s %12s %12s %10s %8s %9s", "name", "min", "mean", "max", "stddev", "imb. [%]", "max rank", "processes");
+  hemo::hlog << line << std::endl;
+  for (ImbalanceStatistics & s : statistics) {
+    std::snprintf(line, sizeof(line), "%-48s %12.4g %12.4g %12.4g %12.4g %10.2f %8d %9d",
+                  s.name.c_str(), s.min, s.mean, s.max, s.stddev, s.imbalance, s.maxRank, s.processes);
+    hemo::hlog << line << std::endl;
+  }
+}
+
 void Profiler::outputStatistics() {
-  this->outputStatistics(plb::global::mpi().getSize());
+  this->outputStatistics(0);
 }
 
-/* Write statistics to file hlog.filename + ".statistics" */
-void Profiler::outputStatistics(int batchsize=INT_MAX) {
-  std::fstream sout;
-  bool opened = false;
-//  global.statistics.getCurrent()["outputStats"].start();
+/* Write statistics of all processes to file hlog.filename + ".statistics"
+ *
+ * Every process renders its own JSON fragment, the fragments are written with
+ * one collective MPI-IO call at offsets computed with MPI_Exscan, which
+ * results in a single well-formed JSON object keyed by rank.
+ * The argument is passed to MPI-IO as the number of aggregators (cb_nodes),
+ * 0 leaves the choice to the MPI library.
+ */
+void Profiler::outputStatistics(int aggregators) {
+  int rank = plb::global::mpi().getRank();
+  int size = plb::global::mpi().getSize();
+
+  std::ostringstream fragment;
+  if (rank > 0) {
+    fragment << "," << std::endl;
+  }
+  fragment << "\"" << rank << "\"" << ": {";
+  printStatistics_JSON(fragment);
+  printMetrics_JSON(fragment);
+  fragment << "}";
+  if (rank == size - 1) {
+    fragment << "}" << std::endl;
+  }
+
   // TODO: Don't static the extention
+  std::string filename = hlog.filename + ".statistics";
+  if (!writeCollective(filename, "{", fragment.str(), aggregators)) {
+    /* If file failed to open, write to logfile */
+    std::cout << "(Profiler) (Error) Opening " + filename << ", outputting everything to logfile instead" << std::endl;
+    hemo::hlog << "Process " << rank << ":" << std::endl;
+    printStatistics_inner(1,hlog.logfile);
+  }
+}
+
+/* Write header (from process 0) followed by the records of all processes in
+ * rank order to a single file. Communication is one MPI_Exscan plus the
+ * collective write itself. */
+bool Profiler::writeCollective(const std::string & filename, const std::string & header, const std::string & record, int aggregators) {
   int rank = plb::global::mpi().getRank();
-  batchsize = std::min(batchsize,plb::global::mpi().getSize());
-
-  for (int batchid = 0; batchid < batchsize; batchid++) {
-    /* Let all mpi processes wait for turn */
-    if (rank % batchsize == batchid) {
-
-      // TODO: Don't static the extention
-      sout.open(hlog.filename + ".statistics." + std::to_string(rank / batchsize) ,std::fstream::app);
-
-      /* If file failed to open, write to logfile */
-      if (!sout.is_open()) {
-        std::cout << "(Profiler) (Error) Opening " + hlog.filename << ".statistics, outputting everything to logfile instead" << std::endl;
-        hemo::hlog << "Process " << plb::global::mpi().getRank() << ":" << std::endl;
-        printStatistics_inner(1,hlog.logfile);
-     } else {
-        opened = true;
-        
-        /* If first write start of JSON output */
-        if(rank % batchsize == 0){
-          sout << "{";
-        }
+  MPI_Comm comm = plb::global::mpi().getGlobalCommunicator();
+
+  unsigned long long size = record.size();
+  unsigned long long offset = 0;
+  MPI_Exscan(&size, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+  if (rank == 0) { offset = 0; }
+  offset += header.size();
+
+  MPI_Info info;
+  MPI_Info_create(&info);
+  MPI_Info_set(info, "romio_cb_write", "enable");
+  if (aggregators > 0) {
+    MPI_Info_set(info, "cb_nodes", std::to_string(aggregators).c_str());
+  }
 
-        sout << "\"" << rank << "\"" << ": {";
-        printStatistics_JSON(sout);
-        printMetrics_JSON(sout);
-        sout << "}";
+  MPI_File fh;
+  int error = MPI_File_open(comm, filename.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, info, &fh);
+  MPI_Info_free(&info);
+  if (error != MPI_SUCCESS) {
+    return false;
+  }
 
-        /* If last write closing JSON ouptut */
-        if(rank % batchsize == batchsize - 1){
-          sout << "}" << std::endl;
-        } else {
-          sout << "," << std::endl;
-        }
+  MPI_File_set_size(fh, 0);
+  if (rank == 0) {
+    MPI_File_write_at(fh, 0, header.data(), header.size(), MPI_BYTE, MPI_STATUS_IGNORE);
+  }
+  MPI_File_write_at_all(fh, offset, record.data(), record.size(), MPI_BYTE, MPI_STATUS_IGNORE);
+  MPI_File_close(&fh);
+  return true;
+}
 
-     }
-     if (opened) {
-       sout.close();
-     }
-   }
- 
-    plb::global::mpi().barrier();
-  }  
+void Profiler::enableTimeSeries(unsigned int binSize, unsigned int capacity) {
+  TimeSeries & series = root->registry->series;
+  series = TimeSeries();
+  if (binSize == 0 || capacity == 0) { return; }
+  series.binSize = binSize;
+  series.capacity = capacity;
+  series.iterations.resize(capacity, 0);
+
+  /* The first bin starts now */
+  tick_t time = now();
+  for (TimerState & s : root->registry->state) {
+    series.last.push_back(s.started ? s.total + (time - s.start) : s.total);
+  }
+  series.seconds.resize(series.last.size(), std::vector<float>(capacity, 0.0f));
+}
 
-//  global.statistics.getCurrent().stop();
+void Profiler::closeBin(unsigned long iteration) {
+  Registry & reg = *root->registry;
+  TimeSeries & series = reg.series;
+  if (iteration == series.lastIteration) { return; }
+
+  tick_t time = now();
+  double scale = secondsPerTick();
+  /* Timers created since the last bin start at zero */
+  series.last.resize(reg.state.size(), 0);
+  series.seconds.resize(reg.state.size(), std::vector<float>(series.capacity, 0.0f));
+
+  for (std::size_t i = 0; i < reg.state.size(); i++) {
+    TimerState & s = reg.state[i];
+    tick_t total = s.started ? s.total + (time - s.start) : s.total;
+    /* A reset timer restarts counting from zero */
+    tick_t spent = total >= series.last[i] ? total - series.last[i] : total;
+    series.seconds[i][series.head] = spent * scale;
+    series.last[i] = total;
+  }
+  series.iterations[series.head] = iteration;
+  series.head = (series.head + 1) % series.capacity;
+  series.bins++;
+  series.lastIteration = iteration;
 }
 
+std::string Profiler::path() {
+  return isRoot() ? name : parent->path() + "/" + name;
+}
 
-Profiler & Profiler::operator[] (std::string name) {
-  //try_emplace from c++17 would be sooo nice here, but gcc 5.4 does not yet have it
-  if (timers.find(name) == timers.end()) {
-    timers.insert(std::pair<std::string,Profiler>(name,Profiler(name, *this)));
+namespace {
+template<typename V>
+void appendBinary(std::string & buffer, const V & value) {
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(V));
+}
+}
+
+/* Write the time series to hlog.filename + ".timeseries"
+ *
+ * Layout: a header written by process 0 followed by one record per process
+ * in rank order.
+ */
+void Profiler::outputTimeSeries() {
+  Registry & reg = *root->registry;
+  TimeSeries & series = reg.series;
+  if (series.binSize == 0) { return; }
+
+  /* Close the last (partial) bin */
+  closeBin(series.currentIteration);
+
+  int rank = plb::global::mpi().getRank();
+  std::uint32_t nBins = std::min<unsigned long>(series.bins, series.capacity);
+  std::uint32_t first = (series.head + series.capacity - nBins) % series.capacity;
+
+  std::string header = "HCPROFTS";
+  appendBinary(header, std::uint32_t(1));
+  appendBinary(header, std::uint32_t(plb::global::mpi().getSize()));
+  appendBinary(header, std::uint32_t(series.binSize));
+  appendBinary(header, std::uint32_t(series.capacity));
+
+  std::string record;
+  appendBinary(record, std::uint32_t(rank));
+  appendBinary(record, std::uint32_t(series.seconds.size()));
+  appendBinary(record, nBins);
+  appendBinary(record, std::uint32_t(0));
+  for (std::uint32_t b = 0; b < nBins; b++) {
+    appendBinary(record, std::uint64_t(series.iterations[(first + b) % series.capacity]));
+  }
+  for (std::size_t i = 0; i < series.seconds.size(); i++) {
+    std::string name_ = reg.byId[i]->path();
+    appendBinary(record, std::uint16_t(name_.size()));
+    record.append(name_);
+    for (std::uint32_t b = 0; b < nBins; b++) {
+      appendBinary(record, series.seconds[i][(first + b) % series.capacity]);
+    }
+  }
+
+  std::string filename = hlog.filename + ".timeseries";
+  if (!writeCollective(filename, header, record, 0)) {
+    hemo::hlog << "(Profiler) (Error) Opening " << filename << ", time series is not written" << std::endl;
+  }
+}
+
+Profiler::TimerId Profiler::intern(const std::string & name_) {
+  Registry & reg = *root->registry;
+  std::uint32_t nameId;
+  std::unordered_map<std::string,std::uint32_t>::iterator found = reg.names.find(name_);
+  if (found == reg.names.end()) {
+    nameId = reg.names.size();
+    reg.names.emplace(name_, nameId);
+  } else {
+    nameId = found->second;
+    for (std::pair<std::uint32_t,Profiler *> & timer_pair : timers) {
+      if (timer_pair.first == nameId) { return timer_pair.second->id; }
+    }
   }
-  return timers.at(name);
+
+  TimerId newId = reg.byId.size();
+  reg.nodes.emplace_back(new Profiler(name_, *this, newId));
+  reg.byId.push_back(reg.nodes.back().get());
+  reg.state.emplace_back();
+  reg.counters.emplace_back();
+  timers.emplace_back(nameId, reg.nodes.back().get());
+  return newId;
+}
+
+Profiler & Profiler::timer(TimerId id_) {
+  return *root->registry->byId[id_];
+}
+
+Profiler & Profiler::operator[] (std::string name) {
+  return timer(intern(name));
 };
 
 Profiler & Profiler::getCurrent() {
-  if (this != &parent) {
+  if (!isRoot()) {
     hemo::hlog << "(Profiler) (Warning) getCurrent called from non-root Profiler object, this will probably be incorrect" << std::endl;
   }
-  return *current;
+  return *root->current;
 }
 
 std::string Profiler::toString(std::chrono::high_resolution_clock::duration time) {
@@ -25,9 +25,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef PROFILER_H
 #define PROFILER_H
 
+#include <array>
 #include <chrono>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include <logfile.h>
 
 namespace hemo {
@@ -35,38 +40,197 @@ namespace hemo {
  * Profiler is a class that can be used to track (wall clock) time spent between
  * start and stop invocations. Start and stop can be invoked multiple times per
  * object.
- * 
+ *
  * Profiler supports hierarchy, with the [string] operator you can start or
  * retrieve subtimers.
- * 
+ *
  * Profiler has a getCurrent() function which can be used to retrieve the last
  * started (sub)timer. With this functionality you can time a function
  * which is called through different paths as different functions in the
  * hierarchy.
+ *
+ * All timers of a hierarchy live in flat storage owned by the root profiler.
+ * Hot code should resolve a timer once with intern() and afterwards use
+ * timer(id), which avoids any string handling. start() and stop() are O(1)
+ * unless child timers are still running.
+ *
+ * Timestamps are taken from std::chrono::steady_clock. When compiled with
+ * HEMO_PROFILER_TSC on x86 the time stamp counter is read instead, it is
+ * converted to seconds using the steady clock over the lifetime of the root
+ * profiler (this requires an invariant TSC, which all recent x86 cpus have).
+ *
+ * Besides the cumulative totals the profiler can record a time series: after
+ * enableTimeSeries() every call to sample() closes a bin once binSize
+ * iterations have passed, the time each timer spent in that bin is kept in a
+ * ring buffer holding the last `capacity` bins. outputTimeSeries() writes the
+ * series of all processes to a single binary file, see
+ * scripts/read-timeseries.py for the layout.
+ *
+ * printImbalance() reduces every timer and numeric metric over all processes
+ * and reports the spread, so every run reports its own load imbalance.
+ *
+ * When compiled with HEMO_PROFILER_PERF on Linux, enableCounters() opens
+ * hardware counters (cycles, instructions, last level cache misses and
+ * branch misses) with perf_event_open. From then on every start() and
+ * stop() also reads them, and every timer in the statistics JSON becomes an
+ * object with the counters and the derived IPC next to its "Total". Only the
+ * thread that called enableCounters() is counted.
+ *
+ * Profiler is not thread safe, only time from the thread driving the
+ * simulation.
  */
 class Profiler {
 public:
+  /* Spread of a single timer or numeric metric over all processes */
+  struct ImbalanceStatistics {
+    std::string name;
+    double min;
+    double max;
+    double mean;
+    double stddev;
+    /* (max / mean - 1) * 100 */
+    double imbalance;
+    /* rank of the process with the maximum value */
+    int maxRank;
+    /* number of processes that have it, the others count as 0 */
+    int processes;
+  };
+
+  typedef std::uint32_t TimerId;
+  typedef std::uint64_t tick_t;
+
+  enum Counter { CYCLES, INSTRUCTIONS, LLC_MISSES, BRANCH_MISSES, N_COUNTERS };
+  typedef std::array<std::uint64_t, N_COUNTERS> HardwareCounters;
+
   Profiler(std::string name_);
-  Profiler(std::string name_, Profiler & parent_);
+  Profiler(Profiler && other);
+  Profiler(const Profiler &) = delete;
+  Profiler & operator=(const Profiler &) = delete;
 
   void start();
   void stop();
   void reset();
   void printStatistics();
+  /* Collectively write the statistics of all processes to hlog.filename + ".statistics",
+   * the argument is the number of MPI-IO aggregators (0: chosen by MPI) */
   void outputStatistics();
   void outputStatistics(int);
 
+  /* Record the time of every timer per bin of binSize iterations */
+  void enableTimeSeries(unsigned int binSize, unsigned int capacity);
+  /* Call once per iteration on the root, closes a bin every binSize iterations */
+  void sample(unsigned long iteration) {
+    TimeSeries & series = root->registry->series;
+    series.currentIteration = iteration;
+    if (series.binSize && iteration % series.binSize == 0) { closeBin(iteration); }
+  }
+  /* Write the time series of all processes to hlog.filename + ".timeseries" */
+  void outputTimeSeries();
+
   /* function for adding extra info to be stored on the profiler output */
   void addMetric(std::string, std::string);
-  
+  /* numeric metrics are also included in the imbalance report */
+  void addMetric(std::string, double);
+
+  /* Collective, reduces the timers and numeric metrics of all processes,
+   * the result is only filled in on process 0 */
+  std::vector<ImbalanceStatistics> computeImbalance();
+  /* Collective, prints the result of computeImbalance through hlog */
+  void printImbalance();
+
+  /* Open the hardware counters for the calling thread, false (with a
+   * warning) when they are not compiled in or the kernel refuses them */
+  bool enableCounters();
+  bool countersEnabled();
+  /* Whether this counter could be opened, unavailable counters read 0 */
+  bool counterAvailable(Counter);
+  /* The counters of the calling thread since enableCounters() */
+  HardwareCounters readCounters();
+  /* The counters accumulated by this timer */
+  HardwareCounters counters();
+
   std::chrono::high_resolution_clock::duration elapsed();
   std::string elapsed_string();
+  /* number of completed start/stop pairs */
+  std::uint64_t calls();
+  /* Elapsed seconds summed over all timers of this hierarchy with this name */
+  double totalSeconds(const std::string &);
   Profiler & operator[] (std::string);
   Profiler & getCurrent();
 
+  /* Resolve (and create if needed) the subtimer with this name once, the id
+   * stays valid for the lifetime of the root profiler */
+  TimerId intern(const std::string &);
+  /* Retrieve any timer of this hierarchy by its interned id */
+  Profiler & timer(TimerId);
+  TimerId getId() const { return id; }
+  const std::string & getName() const { return name; }
+
   std::string static toString(std::chrono::high_resolution_clock::duration);
 
 private:
+  /* Hot state of a single timer, stored contiguously in the root */
+  struct TimerState {
+    tick_t total = 0;
+    tick_t start = 0;
+    std::uint64_t calls = 0;
+    std::uint32_t running_children = 0;
+    bool started = false;
+  };
+  /* Hardware counters of a single timer, only used after enableCounters() */
+  struct CounterState {
+    HardwareCounters total = {};
+    HardwareCounters start = {};
+  };
+  /* Ring buffer of per-bin timings, one row per timer */
+  struct TimeSeries {
+    unsigned int binSize = 0;
+    unsigned int capacity = 0;
+    unsigned int head = 0;
+    unsigned long bins = 0;
+    unsigned long lastIteration = 0;
+    unsigned long currentIteration = 0;
+    std::vector<unsigned long> iterations;
+    std::vector<tick_t> last;
+    std::vector<std::vector<float>> seconds;
+  };
+  /* Storage shared by the whole hierarchy, owned by the root */
+  struct Registry {
+    std::vector<std::unique_ptr<Profiler>> nodes;
+    std::vector<Profiler *> byId;
+    std::vector<TimerState> state;
+    std::unordered_map<std::string, std::uint32_t> names;
+    std::vector<CounterState> counters;
+    TimeSeries series;
+    tick_t created_ticks;
+    std::chrono::steady_clock::time_point created_time;
+    /* perf_event group leader (-1: counters disabled), all descriptors and
+     * the position of every Counter in the group (-1: not available) */
+    int counterLeader = -1;
+    std::vector<int> counterFds;
+    std::array<int, N_COUNTERS> counterSlot;
+
+    ~Registry();
+  };
+
+  Profiler(std::string name_, Profiler & parent_, TimerId id_);
+
+  static tick_t now();
+  void closeBin(unsigned long iteration);
+  bool writeCollective(const std::string & filename, const std::string & header, const std::string & record, int aggregators);
+  std::string path();
+  double secondsPerTick();
+  double ticksToSeconds(tick_t);
+  std::chrono::high_resolution_clock::duration ticksToDuration(tick_t);
+  TimerState & state() { return root->registry->state[id]; }
+  bool isRoot() const { return parent == nullptr; }
+  bool counting() const { return root->registry->counterLeader >= 0; }
+  /* Add the counters since the start of this timer to its total */
+  void addCounters();
+
+  /* children by name, the order of the reports */
+  std::vector<Profiler *> sortedTimers();
+
   void stop_nowarn();
   template<typename T>
   void printStatistics_inner(int level, T & out);
@@ -74,13 +238,17 @@ private:
   void printStatistics_JSON(T & out);
   template<typename T>
   void printMetrics_JSON(T & out);
-  std::chrono::high_resolution_clock::duration total_time = std::chrono::high_resolution_clock::duration::zero();
-  std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
-  bool started = false;
+  template<typename T>
+  void printCounters_JSON(T & out);
   const std::string name;
-  std::map<std::string,Profiler> timers;
+  /* children as (interned name, timer) pairs in creation order, reported sorted by name */
+  std::vector<std::pair<std::uint32_t, Profiler *>> timers;
   std::map<std::string,std::string> metrics;
-  Profiler & parent;
+  std::map<std::string,double> numericMetrics;
+  Profiler * parent;
+  Profiler * root;
+  TimerId id;
+  std::unique_ptr<Registry> registry;
   Profiler * current = this;
 };
 }
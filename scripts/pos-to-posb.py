@@ -0,0 +1,118 @@
+#! python3
+# Convert a text .pos file to the binary .posb format read by misc/cellPositions.h.
+#
+# File layout (native byte order):
+# Header, 64 bytes:
+# - char[8]     magic "HCPOSB\0\0"
+# - uint32      version
+# - uint32      flags, 1: the file has a spatial index
+# - uint64      number of cells
+# - float32[3]  minimum position
+# - float32[3]  maximum position
+# - uint32[3]   index grid
+# - uint32      reserved
+#
+# - float32 x[n], y[n], z[n], rx[n], ry[n], rz[n]
+# - uint32 id[n], the line of the cell in the .pos file, padded to 8 bytes
+# - if indexed: uint64 start[gx * gy * gz + 1], the cells are sorted by the grid
+#   bucket (x major, z fastest) their position falls in, bucket b holds the
+#   cells start[b] up to start[b + 1]
+
+import argparse
+import math
+import struct
+from array import array
+
+MAGIC = b"HCPOSB\0\0"
+VERSION = 1
+INDEXED = 1
+
+
+def read_pos(filename):
+    """ Read a .pos file into a list of (x, y, z, rx, ry, rz, id) tuples """
+    with open(filename) as f:
+        count = int(f.readline())
+        cells = []
+        for i, line in enumerate(f):
+            if i == count:
+                break
+            values = [float(v) for v in line.split()[:6]]
+            cells.append(tuple(values) + (i,))
+    return cells
+
+
+def index_grid(lo, hi, bucket, grid):
+    """ Number of buckets along every axis, either given or from the bucket size (micrometer) """
+    if grid is not None:
+        return grid
+    return [max(1, int(math.ceil((hi[d] - lo[d]) / bucket))) for d in range(3)]
+
+
+def bucket_of(cell, lo, hi, grid):
+    index = []
+    for d in range(3):
+        extent = hi[d] - lo[d]
+        width = extent / grid[d] if extent > 0 else 1.0
+        index.append(min(grid[d] - 1, int((cell[d] - lo[d]) / width)))
+    return (index[0] * grid[1] + index[1]) * grid[2] + index[2]
+
+
+def write_posb(filename, cells, grid=None, bucket=20.0, indexed=True):
+    n = len(cells)
+    # use the float32 rounded bounds, the reader computes the buckets with them
+    lo = array("f", [min((c[d] for c in cells), default=0.0) for d in range(3)]).tolist()
+    hi = array("f", [max((c[d] for c in cells), default=0.0) for d in range(3)]).tolist()
+
+    if indexed:
+        grid = index_grid(lo, hi, bucket, grid)
+        buckets = [bucket_of(array("f", c[:3]).tolist(), lo, hi, grid) for c in cells]
+        order = sorted(range(n), key=lambda i: buckets[i])
+    else:
+        grid = [0, 0, 0]
+        order = range(n)
+
+    header = MAGIC + struct.pack("=IIQ3f3f3II", VERSION, INDEXED if indexed else 0, n,
+                                 *lo, *hi, *grid, 0)
+    assert len(header) == 64
+
+    with open(filename, "wb") as f:
+        f.write(header)
+        for d in range(6):
+            f.write(array("f", [cells[i][d] for i in order]).tobytes())
+        f.write(array("I", [cells[i][6] for i in order]).tobytes())
+        if n % 2:
+            f.write(b"\0" * 4)
+
+        if indexed:
+            start = [0] * (grid[0] * grid[1] * grid[2] + 1)
+            for b in buckets:
+                start[b + 1] += 1
+            for b in range(1, len(start)):
+                start[b] += start[b - 1]
+            f.write(array("Q", start).tobytes())
+
+    return grid
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("input", type=str, help="The .pos file")
+    parser.add_argument("-o", "--output", type=str, help="Name of the .posb output file", default=None)
+    parser.add_argument("--bucket", type=float, default=20.0,
+                        help="Edge of an index bucket in micrometer (default: 20)")
+    parser.add_argument("--grid", type=int, nargs=3, default=None,
+                        help="Number of index buckets along x, y and z, overrides --bucket")
+    parser.add_argument("--no_index", action="store_true", help="Do not write the spatial index")
+    args = parser.parse_args()
+
+    if args.output is None:
+        args.output = (args.input[:-4] if args.input.endswith(".pos") else args.input) + ".posb"
+
+    cells = read_pos(args.input)
+    grid = write_posb(args.output, cells, args.grid, args.bucket, not args.no_index)
+    print(f"Wrote {len(cells)} cells to {args.output}" +
+          ("" if args.no_index else f" with a {grid[0]}x{grid[1]}x{grid[2]} index"))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,78 @@
+#! python3
+# Convert the binary time series written by Profiler::outputTimeSeries to csv.
+#
+# File layout (native byte order):
+# Header:
+# - char[8]  magic "HCPROFTS"
+# - uint32   version
+# - uint32   number of processes
+# - uint32   bin size in iterations
+# - uint32   ring buffer capacity in bins
+#
+# One record per process, in rank order:
+# - uint32   rank
+# - uint32   number of timers
+# - uint32   number of bins
+# - uint32   reserved
+# - uint64   last iteration of every bin
+# - for every timer: uint16 name length, the path of the timer ("HemoCell/iterate/...")
+#   and a float32 per bin with the seconds spent in that bin
+
+import argparse
+import struct
+import numpy as np
+import pandas as pd
+
+MAGIC = b"HCPROFTS"
+
+
+def read_timeseries(filename):
+    """ Read a .timeseries file into a DataFrame with columns rank, timer, iteration, seconds """
+
+    with open(filename, "rb") as f:
+        data = f.read()
+
+    if data[:8] != MAGIC:
+        raise ValueError(f"{filename} is not a profiler time series file")
+
+    version, nprocs, bin_size, capacity = struct.unpack_from("=IIII", data, 8)
+    offset = 24
+
+    frames = []
+    for _ in range(nprocs):
+        rank, ntimers, nbins, _ = struct.unpack_from("=IIII", data, offset)
+        offset += 16
+        iterations = np.frombuffer(data, dtype=np.uint64, count=nbins, offset=offset)
+        offset += 8 * nbins
+
+        for _ in range(ntimers):
+            (length,) = struct.unpack_from("=H", data, offset)
+            offset += 2
+            name = data[offset:offset + length].decode("utf-8")
+            offset += length
+            seconds = np.frombuffer(data, dtype=np.float32, count=nbins, offset=offset)
+            offset += 4 * nbins
+
+            frames.append(pd.DataFrame({"rank": rank, "timer": name,
+                                        "iteration": iterations, "seconds": seconds}))
+
+    if not frames:
+        return pd.DataFrame(columns=["rank", "timer", "iteration", "seconds"])
+
+    return pd.concat(frames, ignore_index=True)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("input", type=str, help="The .timeseries file written by the profiler")
+    parser.add_argument("-o", "--output", type=str, help="Name of the csv output file", default=None)
+    args = parser.parse_args()
+
+    if args.output is None:
+        args.output = args.input + ".csv"
+
+    read_timeseries(args.input).to_csv(args.output, index=False)
+
+
+if __name__ == "__main__":
+    main()
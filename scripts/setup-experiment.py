@@ -399,6 +399,8 @@ def main():
     parser.add_argument("--fli_part_base", type=int, help="Fractional imbalance part", default=0)
     parser.add_argument("--fli_part_stack", type=bool, help="If true RBCs are stacked", default=False)
     parser.add_argument("--ELI_case", type=int, help="Case type from embracing load imbalance paper cases", default=1)
+    parser.add_argument("--block_layout", type=str, help="Numbering of the atomic blocks=[xyz,hilbert]", default=None)
+    parser.add_argument("--attribution", type=str, help="Block to process attribution, see hemocell-bench/blockAttribution.h", default=None)
 
     #Still need to setup
     parser.add_argument("-v", "--log", type=str, help="Loggin level=[DEBUG,INFO,WARNING,ERROR,CRITICAL]", default="WARNING")
@@ -408,5 +410,10 @@ def main():
     exp = FractionalImbalance.from_args(args)
     exp.create()
 
+    if args.block_layout is not None:
+        exp.write_to_config("benchmark", "blockLayout", args.block_layout)
+    if args.attribution is not None:
+        exp.write_to_config("benchmark", "attribution", args.attribution)
+
 if __name__ == "__main__":
     main()
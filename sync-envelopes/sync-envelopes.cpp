@@ -0,0 +1,201 @@
+/*
+This file is part of the HemoCell library
+
+HemoCell is developed and maintained by the Computational Science Lab
+in the University of Amsterdam. Any questions or remarks regarding this library
+can be sent to: info@hemocell.eu
+
+When using the HemoCell library in scientific work please cite the
+corresponding paper: https://doi.org/10.3389/fphys.2017.00563
+
+The HemoCell library is free software: you can redistribute it and/or
+modify it under the terms of the GNU Affero General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+The library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "cubeBenchmark.h"
+#include "particleHelpers.h"
+
+#include "palabos3D.h"
+#include "palabos3D.hh"
+
+#include <algorithm>
+#include <set>
+
+using namespace hemo;
+
+/*
+ * Only the envelope exchange of the cube case: every iteration the fluid
+ * envelope (<domain><fluidEnvelope>) and the particle envelope
+ * (<domain><particleEnvelope>) are synchronised, nothing is computed.
+ *
+ * The number of blocks is <blockMultiply> per process, their size follows
+ * from the domain, or from <scaling><abSize> in the weak scaling mode. The
+ * neighbour distance is set with <rankStride>: the process of every block of
+ * the contiguous attribution is multiplied by the stride (modulo the number
+ * of processes), so blocks that are neighbours in the domain end up stride
+ * processes apart, on other nodes for large strides.
+ *
+ * The bytes and messages a process receives per exchange follow from the
+ * overlaps with blocks of other processes, the latency of every exchange
+ * is measured after <warmupExchanges> untimed ones. tmax is the number of
+ * exchanges.
+ */
+class SyncEnvelopes : public bench::CubeBenchmark {
+public:
+  SyncEnvelopes(int argc, char *argv[]) : bench::CubeBenchmark(argc, argv)
+  {
+    rankStride = benchmarkOption<plint>("rankStride", 1);
+    warmupExchanges = benchmarkOption<unsigned int>("warmupExchanges", 10);
+    hlog << "rankStride : " << rankStride << ", warmupExchanges : " << warmupExchanges << endl;
+    // nothing is computed, MLUPS would only measure the exchange
+    reportThroughput = false;
+
+    plint nProcs = global::mpi().getSize();
+    plint a = rankStride, b = nProcs;
+    while (b != 0) {
+      plint rest = a % b;
+      a = b;
+      b = rest;
+    }
+    if (rankStride < 1 || a != 1) {
+      hlog << "(SyncEnvelopes) (Error) <rankStride> " << rankStride << " must be positive and coprime with the "
+           << nProcs << " processes" << endl;
+      exit(1);
+    }
+  }
+
+protected:
+  void createLattice() override {
+    if (!scalingGrid.empty()) {
+      bench::CubeBenchmark::createLattice();
+    } else {
+      createAttributedLattice(global::mpi().getSize() * benchmarkOption<int>("blockMultiply", 1), "contiguous");
+    }
+  }
+
+  bench::BlockAttribution attributeBlocks(SparseBlockStructure3D const & sb, std::string const & fallback) override {
+    bench::BlockAttribution attribution = bench::CubeBenchmark::attributeBlocks(sb, fallback);
+    const plint nProcs = global::mpi().getSize();
+    for (auto & block : attribution) {
+      block.second = (block.second * rankStride) % nProcs;
+    }
+    return attribution;
+  }
+
+  void beforeLoop() override {
+    bench::CubeBenchmark::beforeLoop();
+    for (unsigned int i = 0; i < warmupExchanges; i++) {
+      exchange();
+    }
+  }
+
+  /* One exchange instead of an iteration */
+  void step() override {
+    double start = MPI_Wtime();
+    hemocell.lattice->duplicateOverlaps(modif::population);
+    double fluid = MPI_Wtime() - start;
+    hemocell.cellfields->syncEnvelopes();
+    double total = MPI_Wtime() - start;
+
+    fluidSeconds.push_back(fluid);
+    particleSeconds.push_back(total - fluid);
+    hemocell.iter++;
+  }
+
+  void exchange() {
+    hemocell.lattice->duplicateOverlaps(modif::population);
+    hemocell.cellfields->syncEnvelopes();
+  }
+
+  void finish() override {
+    // fluid: cells of the envelope this process receives from other processes
+    MultiBlockManagement3D const & fluidManagement = hemocell.lattice->getMultiBlockManagement();
+    double fluidCells = 0.;
+    std::set<int> fluidSources;
+    for (Overlap3D const & overlap : remoteOverlaps(fluidManagement)) {
+      fluidCells += overlap.getOverlapCoordinates().nCells();
+      fluidSources.insert(fluidManagement.getThreadAttribution().getMpiProcess(overlap.getOriginalId()));
+    }
+    // modif::population, as in collideAndStream(), only the populations are exchanged
+    const double cellBytes = sizeof(T) * DESCRIPTOR<T>::q;
+
+    // particles: the envelope particles that came from blocks of other processes
+    MultiBlockManagement3D const & particleManagement = hemocell.cellfields->immersedParticles->getMultiBlockManagement();
+    double particles = 0.;
+    std::set<int> particleSources;
+    for (Overlap3D const & overlap : remoteOverlaps(particleManagement)) {
+      Box3D region = overlap.getOverlapCoordinates();
+      particleSources.insert(particleManagement.getThreadAttribution().getMpiProcess(overlap.getOriginalId()));
+      for (HemoCellParticle const & particle : hemocell.cellfields->immersedParticles->getComponent(overlap.getOverlapId()).particles) {
+        if (bench::inBulk(region, particle.sv.position)) { particles += 1.; }
+      }
+    }
+    const double particleBytes = particles * sizeof(HemoCellParticle);
+
+    double fluidMedian = median(fluidSeconds), particleMedian = median(particleSeconds);
+    hemo::global.statistics.addMetric("Envelope Blocks", (double)fluidManagement.getLocalInfo().getBlocks().size());
+    hemo::global.statistics.addMetric("Envelope Rank Stride", (double)rankStride);
+    hemo::global.statistics.addMetric("Fluid Envelope Bytes", fluidCells * cellBytes);
+    hemo::global.statistics.addMetric("Fluid Envelope Messages", (double)fluidSources.size());
+    hemo::global.statistics.addMetric("Fluid Envelope Latency Median", fluidMedian);
+    hemo::global.statistics.addMetric("Fluid Envelope Latency Min", minimum(fluidSeconds));
+    hemo::global.statistics.addMetric("Fluid Envelope Latency Max", maximum(fluidSeconds));
+    hemo::global.statistics.addMetric("Particle Envelope Bytes", particleBytes);
+    hemo::global.statistics.addMetric("Particle Envelope Messages", (double)particleSources.size());
+    hemo::global.statistics.addMetric("Particle Envelope Latency Median", particleMedian);
+    hemo::global.statistics.addMetric("Particle Envelope Latency Min", minimum(particleSeconds));
+    hemo::global.statistics.addMetric("Particle Envelope Latency Max", maximum(particleSeconds));
+
+    hlog << "(SyncEnvelopes) fluid: " << fluidCells * cellBytes << " bytes in " << fluidSources.size()
+         << " messages, median " << fluidMedian << " s; particles: " << particleBytes << " bytes in "
+         << particleSources.size() << " messages, median " << particleMedian << " s (process 0)" << endl;
+
+    bench::CubeBenchmark::finish();
+  }
+
+  /* Normal and periodic overlaps through which a local block receives from a block of another process:
+   * the data of the original block is copied into the envelope of the overlap block */
+  std::vector<Overlap3D> remoteOverlaps(MultiBlockManagement3D const & management) {
+    ThreadAttribution const & attribution = management.getThreadAttribution();
+    std::vector<Overlap3D> overlaps = management.getLocalInfo().getNormalOverlaps();
+    for (PeriodicOverlap3D const & periodic : management.getLocalInfo().getPeriodicOverlaps()) {
+      overlaps.push_back(periodic.overlap);
+    }
+    std::vector<Overlap3D> remote;
+    for (Overlap3D const & overlap : overlaps) {
+      if (attribution.isLocal(overlap.getOverlapId()) && !attribution.isLocal(overlap.getOriginalId())) {
+        remote.push_back(overlap);
+      }
+    }
+    return remote;
+  }
+
+  static double median(std::vector<double> values) {
+    if (values.empty()) { return 0.; }
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+  }
+  static double minimum(std::vector<double> const & values) {
+    return values.empty() ? 0. : *std::min_element(values.begin(), values.end());
+  }
+  static double maximum(std::vector<double> const & values) {
+    return values.empty() ? 0. : *std::max_element(values.begin(), values.end());
+  }
+
+  plint rankStride;
+  unsigned int warmupExchanges;
+  std::vector<double> fluidSeconds, particleSeconds;
+};
+
+int main(int argc, char *argv[]) {
+  return bench::runBenchmark<SyncEnvelopes>(argc, argv);
+}